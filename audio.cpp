@@ -0,0 +1,554 @@
+// Audio
+//
+// Voices are mixed on SDL's audio thread, inside the audio callback. The
+// game thread never touches the voices: it sends commands through a
+// single-producer single-consumer ring, which the callback drains before
+// every buffer. The mixer is allocated up front and the audio thread
+// never allocates, locks or waits.
+//
+// Each voice is resampled with linear interpolation, 32.32 fixed point
+// positions keeping long loops from drifting. Interpolation, the pan and
+// volume ramps and the accumulation run LANE_WIDTH frames at a time; only
+// the sample fetch is scalar, since SSE2 has no gather.
+
+internal Sound
+allocateSound( uint32 frameCount, real32 sampleRate )
+{
+        Sound sound;
+        sound.samples = (real32*)calloc( frameCount + 1, sizeof(real32) );
+        sound.frameCount = frameCount;
+        sound.sampleRate = sampleRate;
+        return sound;
+}
+
+internal void
+freeSound( Sound* sound )
+{
+        free( sound->samples );
+        sound->samples = 0;
+        sound->frameCount = 0;
+}
+
+// A sine tone that decays exponentially, fading out by the end
+internal Sound
+makeToneSound( real32 frequency, real32 seconds, real32 sampleRate, real32 decay )
+{
+        uint32 frameCount = (uint32)(seconds * sampleRate);
+        Sound sound = allocateSound( frameCount, sampleRate );
+
+        real32 tau = 2.0f * 3.14159265f;
+        for ( uint32 frame = 0; frame < frameCount; ++frame )
+        {
+                real32 time = frame / sampleRate;
+                sound.samples[frame] = sinf( tau * frequency * time ) * expf( -decay * time );
+        }
+        sound.samples[frameCount] = sound.samples[0];
+
+        return sound;
+}
+
+//
+// Command ring
+//
+
+internal bool32
+pushAudioCommand( AudioMixer* mixer, AudioCommand command )
+{
+        AudioCommandRing* ring = &mixer->commands;
+
+        uint32 writeIndex = (uint32)SDL_AtomicGet( &ring->writeIndex );
+        uint32 readIndex = (uint32)SDL_AtomicGet( &ring->readIndex );
+        if ( writeIndex - readIndex >= AUDIO_COMMAND_COUNT )
+        {
+                ++mixer->droppedCommands;
+                return false;
+        }
+
+        ring->commands[ writeIndex & (AUDIO_COMMAND_COUNT - 1) ] = command;
+
+        // The command has to be visible before the index that publishes it
+        SDL_MemoryBarrierRelease();
+        SDL_AtomicSet( &ring->writeIndex, (int32)(writeIndex + 1) );
+
+        return true;
+}
+
+internal bool32
+popAudioCommand( AudioCommandRing* ring, AudioCommand* command )
+{
+        uint32 readIndex = (uint32)SDL_AtomicGet( &ring->readIndex );
+        uint32 writeIndex = (uint32)SDL_AtomicGet( &ring->writeIndex );
+        if ( readIndex == writeIndex )
+        {
+                return false;
+        }
+        SDL_MemoryBarrierAcquire();
+
+        *command = ring->commands[ readIndex & (AUDIO_COMMAND_COUNT - 1) ];
+
+        // Done reading the slot before handing it back
+        SDL_MemoryBarrierRelease();
+        SDL_AtomicSet( &ring->readIndex, (int32)(readIndex + 1) );
+
+        return true;
+}
+
+// Start a sound, returns the voice id or 0 if the command ring is full.
+// The sound must stay alive for as long as it can be playing.
+internal uint32
+playSound( AudioMixer* mixer, Sound* sound,
+           real32 volume, real32 pan, real32 pitch, bool32 loop )
+{
+        uint32 voiceId = mixer->nextVoiceId++;
+        if ( mixer->nextVoiceId == 0 )
+        {
+                mixer->nextVoiceId = 1;
+        }
+
+        AudioCommand command = {};
+        command.type = AudioCommand_Play;
+        command.voiceId = voiceId;
+        command.sound = sound;
+        command.volume = volume;
+        command.pan = pan;
+        command.pitch = pitch;
+        command.loop = loop;
+
+        uint32 result = pushAudioCommand( mixer, command ) ? voiceId : 0;
+        return result;
+}
+
+internal void
+stopSound( AudioMixer* mixer, uint32 voiceId )
+{
+        AudioCommand command = {};
+        command.type = AudioCommand_Stop;
+        command.voiceId = voiceId;
+        pushAudioCommand( mixer, command );
+}
+
+internal void
+changeSound( AudioMixer* mixer, uint32 voiceId, real32 volume, real32 pan, real32 pitch )
+{
+        AudioCommand command = {};
+        command.type = AudioCommand_Change;
+        command.voiceId = voiceId;
+        command.volume = volume;
+        command.pan = pan;
+        command.pitch = pitch;
+        pushAudioCommand( mixer, command );
+}
+
+internal void
+stopAllSounds( AudioMixer* mixer )
+{
+        AudioCommand command = {};
+        command.type = AudioCommand_StopAll;
+        pushAudioCommand( mixer, command );
+}
+
+//
+// Audio thread
+//
+
+// Constant power pan
+internal void
+setVoiceTargets( AudioVoice* voice, real32 volume, real32 pan )
+{
+        if ( pan < -1.0f ) pan = -1.0f;
+        if ( pan > 1.0f ) pan = 1.0f;
+
+        real32 angle = (pan + 1.0f) * (3.14159265f / 4.0f);
+        voice->targetLeft = volume * cosf( angle );
+        voice->targetRight = volume * sinf( angle );
+}
+
+internal void
+setVoicePitch( AudioMixer* mixer, AudioVoice* voice, real32 pitch )
+{
+        if ( pitch < 0.01f )
+        {
+                pitch = 0.01f;
+        }
+        real64 framesPerFrame = (real64)voice->sound->sampleRate / mixer->sampleRate * pitch;
+        voice->step = (uint64)(framesPerFrame * 4294967296.0);
+}
+
+internal AudioVoice*
+findAudioVoice( AudioMixer* mixer, uint32 voiceId )
+{
+        for ( uint32 i = 0; i < mixer->voiceCount; ++i )
+        {
+                if ( mixer->voices[i].id == voiceId )
+                {
+                        return &mixer->voices[i];
+                }
+        }
+        return 0;
+}
+
+internal void
+processAudioCommands( AudioMixer* mixer )
+{
+        AudioCommand command;
+        while ( popAudioCommand( &mixer->commands, &command ) )
+        {
+                if ( command.type == AudioCommand_Play )
+                {
+                        if ( mixer->voiceCount == AUDIO_MAX_VOICES ||
+                             command.sound->frameCount == 0 )
+                        {
+                                ++mixer->stats.droppedVoices;
+                                continue;
+                        }
+
+                        AudioVoice* voice = &mixer->voices[ mixer->voiceCount++ ];
+                        voice->id = command.voiceId;
+                        voice->sound = command.sound;
+                        voice->loop = command.loop;
+                        voice->stopping = false;
+                        voice->position = 0;
+                        setVoicePitch( mixer, voice, command.pitch );
+                        setVoiceTargets( voice, command.volume, command.pan );
+                        voice->gainLeft = voice->targetLeft;
+                        voice->gainRight = voice->targetRight;
+                }
+                else if ( command.type == AudioCommand_Stop )
+                {
+                        AudioVoice* voice = findAudioVoice( mixer, command.voiceId );
+                        if ( voice )
+                        {
+                                // Fade out over the next buffer
+                                voice->targetLeft = 0;
+                                voice->targetRight = 0;
+                                voice->stopping = true;
+                        }
+                }
+                else if ( command.type == AudioCommand_Change )
+                {
+                        AudioVoice* voice = findAudioVoice( mixer, command.voiceId );
+                        if ( voice && !voice->stopping )
+                        {
+                                setVoicePitch( mixer, voice, command.pitch );
+                                setVoiceTargets( voice, command.volume, command.pan );
+                        }
+                }
+                else if ( command.type == AudioCommand_StopAll )
+                {
+                        for ( uint32 i = 0; i < mixer->voiceCount; ++i )
+                        {
+                                mixer->voices[i].targetLeft = 0;
+                                mixer->voices[i].targetRight = 0;
+                                mixer->voices[i].stopping = true;
+                        }
+                }
+        }
+}
+
+// Add frameCount frames of the voice to the mix buffers, which must have
+// room for frameCount rounded up to LANE_WIDTH. Returns false once the
+// voice is done.
+internal bool32
+mixVoice( AudioMixer* mixer, AudioVoice* voice, uint32 frameCount )
+{
+        static const real32 laneOffsets[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+
+        Sound* sound = voice->sound;
+        real32* samples = sound->samples;
+        uint64 length = (uint64)sound->frameCount << 32;
+        uint64 unitStep = (uint64)1 << 32;
+        uint32 laneFrameCount = (frameCount + LANE_WIDTH - 1) & ~(LANE_WIDTH - 1);
+
+        // Fetch the samples on either side of every output frame first,
+        // so the lane loop below only reads from memory written well
+        // before it
+        real32* from = mixer->fetchFrom;
+        real32* to = mixer->fetchTo;
+        real32* t = mixer->fetchT;
+        bool32 direct = false;
+        bool32 playing = true;
+        if ( voice->step == unitStep &&
+             (voice->position & 0xFFFFFFFF) == 0 &&
+             voice->position + laneFrameCount * unitStep <= length )
+        {
+                // Whole frames at the output rate, nothing to interpolate
+                from = samples + (voice->position >> 32);
+                direct = true;
+                voice->position += frameCount * unitStep;
+        }
+        else
+        {
+                for ( uint32 frame = 0; frame < laneFrameCount; ++frame )
+                {
+                        if ( voice->position >= length )
+                        {
+                                if ( voice->loop )
+                                {
+                                        voice->position %= length;
+                                }
+                                else
+                                {
+                                        playing = false;
+                                }
+                        }
+
+                        if ( playing && frame < frameCount )
+                        {
+                                uint32 index = (uint32)(voice->position >> 32);
+                                from[frame] = samples[index];
+                                to[frame] = samples[index + 1];
+                                t[frame] = (real32)(uint32)voice->position * (1.0f / 4294967296.0f);
+                                voice->position += voice->step;
+                        }
+                        else
+                        {
+                                from[frame] = 0;
+                                to[frame] = 0;
+                                t[frame] = 0;
+                        }
+                }
+        }
+
+        LaneR32 laneOffset = loadLaneR32( laneOffsets );
+        real32 gainStepLeft = (voice->targetLeft - voice->gainLeft) / frameCount;
+        real32 gainStepRight = (voice->targetRight - voice->gainRight) / frameCount;
+
+        real32* mixLeft = mixer->mixLeft;
+        real32* mixRight = mixer->mixRight;
+        for ( uint32 frame = 0; frame < laneFrameCount; frame += LANE_WIDTH )
+        {
+                LaneR32 sample = loadLaneR32( from + frame );
+                if ( !direct )
+                {
+                        sample = sample + loadLaneR32( t + frame ) * (loadLaneR32( to + frame ) - sample);
+                }
+
+                LaneR32 ramp = laneR32( (real32)frame ) + laneOffset;
+                LaneR32 gainLeft = laneR32( voice->gainLeft ) + gainStepLeft * ramp;
+                LaneR32 gainRight = laneR32( voice->gainRight ) + gainStepRight * ramp;
+
+                storeLaneR32( mixLeft + frame, loadLaneR32( mixLeft + frame ) + gainLeft * sample );
+                storeLaneR32( mixRight + frame, loadLaneR32( mixRight + frame ) + gainRight * sample );
+        }
+
+        voice->gainLeft = voice->targetLeft;
+        voice->gainRight = voice->targetRight;
+
+        bool32 result = playing && !voice->stopping;
+        return result;
+}
+
+// Mix every voice into frameCount interleaved stereo frames
+internal void
+mixAudio( AudioMixer* mixer, real32* output, uint32 frameCount )
+{
+        processAudioCommands( mixer );
+
+        while ( frameCount > 0 )
+        {
+                uint32 chunk = frameCount < AUDIO_MIX_FRAMES ? frameCount : AUDIO_MIX_FRAMES;
+                uint32 laneChunk = (chunk + LANE_WIDTH - 1) & ~(LANE_WIDTH - 1);
+
+                memset( mixer->mixLeft, 0, laneChunk * sizeof(real32) );
+                memset( mixer->mixRight, 0, laneChunk * sizeof(real32) );
+
+                for ( uint32 i = 0; i < mixer->voiceCount; )
+                {
+                        if ( mixVoice( mixer, &mixer->voices[i], chunk ) )
+                        {
+                                ++i;
+                        }
+                        else
+                        {
+                                mixer->voices[i] = mixer->voices[ --mixer->voiceCount ];
+                        }
+                }
+                mixer->stats.voiceFramesMixed += (uint64)mixer->voiceCount * chunk;
+
+                LaneR32 lowest = laneR32( -1.0f );
+                LaneR32 highest = laneR32( 1.0f );
+                for ( uint32 frame = 0; frame < laneChunk; frame += LANE_WIDTH )
+                {
+                        LaneR32 left = loadLaneR32( mixer->mixLeft + frame );
+                        LaneR32 right = loadLaneR32( mixer->mixRight + frame );
+                        storeLaneR32( mixer->mixLeft + frame, minimum( maximum( left, lowest ), highest ) );
+                        storeLaneR32( mixer->mixRight + frame, minimum( maximum( right, lowest ), highest ) );
+                }
+                for ( uint32 frame = 0; frame < chunk; ++frame )
+                {
+                        output[2*frame] = mixer->mixLeft[frame];
+                        output[2*frame + 1] = mixer->mixRight[frame];
+                }
+
+                mixer->stats.framesMixed += chunk;
+                output += 2*chunk;
+                frameCount -= chunk;
+        }
+}
+
+internal void
+audioCallback( void* userData, uint8* stream, int32 length )
+{
+        AudioMixer* mixer = (AudioMixer*)userData;
+        uint64 start = getPerformanceCounter();
+
+        uint32 frameCount = (uint32)length / (2 * sizeof(real32));
+        mixAudio( mixer, (real32*)stream, frameCount );
+
+        real64 seconds = getSecondsElapsed( start, getPerformanceCounter() );
+        mixer->stats.mixSeconds += seconds;
+        if ( seconds > mixer->stats.maxCallbackSeconds )
+        {
+                mixer->stats.maxCallbackSeconds = seconds;
+        }
+        ++mixer->stats.callbacks;
+}
+
+// Set up a mixer that is driven by calling mixAudio directly
+internal void
+initializeAudioMixer( AudioMixer* mixer, uint32 sampleRate )
+{
+        mixer->device = 0;
+        mixer->sampleRate = sampleRate;
+        mixer->nextVoiceId = 1;
+        mixer->voiceCount = 0;
+        AudioStats stats = {};
+        mixer->stats = stats;
+        SDL_AtomicSet( &mixer->commands.writeIndex, 0 );
+        SDL_AtomicSet( &mixer->commands.readIndex, 0 );
+}
+
+// Open the default output device (or the one SDL_AUDIODRIVER picks) and
+// start mixing into it
+internal bool32
+openAudioMixer( AudioMixer* mixer )
+{
+        if ( SDL_InitSubSystem( SDL_INIT_AUDIO ) < 0 )
+        {
+                printf( "Audio could not be initialized. SDL_Error: %s\n", SDL_GetError() );
+                return false;
+        }
+
+        initializeAudioMixer( mixer, AUDIO_SAMPLE_RATE );
+
+        // SDL converts to whatever the device wants
+        SDL_AudioSpec desired = {};
+        desired.freq = AUDIO_SAMPLE_RATE;
+        desired.format = AUDIO_F32SYS;
+        desired.channels = 2;
+        desired.samples = AUDIO_BUFFER_FRAMES;
+        desired.callback = audioCallback;
+        desired.userdata = mixer;
+
+        SDL_AudioSpec obtained;
+        mixer->device = SDL_OpenAudioDevice( NULL, 0, &desired, &obtained, 0 );
+        if ( mixer->device == 0 )
+        {
+                printf( "Audio device could not be opened. SDL_Error: %s\n", SDL_GetError() );
+                SDL_QuitSubSystem( SDL_INIT_AUDIO );
+                return false;
+        }
+
+        SDL_PauseAudioDevice( mixer->device, 0 );
+        return true;
+}
+
+// Stops the audio thread, after which the stats are safe to read
+internal void
+closeAudioMixer( AudioMixer* mixer )
+{
+        if ( mixer->device )
+        {
+                SDL_CloseAudioDevice( mixer->device );
+                SDL_QuitSubSystem( SDL_INIT_AUDIO );
+                mixer->device = 0;
+        }
+}
+
+// A spread of pans and pitches, so that both the resampling and the
+// direct path are exercised
+internal void
+playBenchmarkVoices( AudioMixer* mixer, Sound* sounds, uint32 soundCount, uint32 voiceCount )
+{
+        for ( uint32 i = 0; i < voiceCount; ++i )
+        {
+                real32 pan = (real32)(i % 17) / 8.0f - 1.0f;
+                real32 pitch = (i % 3 == 0) ? 1.0f : 0.5f + (real32)(i % 11) / 10.0f;
+                playSound( mixer, &sounds[i % soundCount], 1.0f / voiceCount, pan, pitch, true );
+        }
+}
+
+// Mix voiceCount looping voices as fast as possible, then through the
+// audio device. The device part defaults to the dummy driver so that it
+// runs headless; set SDL_AUDIODRIVER=disk to also write the output.
+internal void
+benchmarkAudio( uint32 voiceCount )
+{
+        if ( voiceCount > AUDIO_MAX_VOICES )
+        {
+                voiceCount = AUDIO_MAX_VOICES;
+        }
+
+        // Sounds at the output rate take the direct path at pitch 1
+        Sound sounds[4];
+        sounds[0] = makeToneSound( 220.0f, 2.0f, 48000.0f, 0.0f );
+        sounds[1] = makeToneSound( 330.0f, 1.5f, 44100.0f, 0.5f );
+        sounds[2] = makeToneSound( 440.0f, 1.0f, 22050.0f, 1.0f );
+        sounds[3] = makeToneSound( 660.0f, 0.5f, 48000.0f, 2.0f );
+
+        AudioMixer* mixer = (AudioMixer*)calloc( 1, sizeof(AudioMixer) );
+        initializeAudioMixer( mixer, AUDIO_SAMPLE_RATE );
+        playBenchmarkVoices( mixer, sounds, 4, voiceCount );
+
+        uint32 seconds = 10;
+        uint32 bufferCount = seconds * AUDIO_SAMPLE_RATE / AUDIO_BUFFER_FRAMES;
+        real32* output = (real32*)malloc( 2 * AUDIO_BUFFER_FRAMES * sizeof(real32) );
+
+        uint64 start = getPerformanceCounter();
+        for ( uint32 i = 0; i < bufferCount; ++i )
+        {
+                mixAudio( mixer, output, AUDIO_BUFFER_FRAMES );
+        }
+        real64 mixSeconds = getSecondsElapsed( start, getPerformanceCounter() );
+
+        real64 voiceFrames = (real64)mixer->stats.voiceFramesMixed;
+        real64 audioSeconds = (real64)mixer->stats.framesMixed / AUDIO_SAMPLE_RATE;
+        printf( "Audio benchmark: %u voices, %d lanes\n", mixer->voiceCount, LANE_WIDTH );
+        printf( "  direct: %.1f s of audio in %.3f s, %.1fx realtime, %.2f ns per voice frame, "
+                "%.0f voices at realtime\n",
+                audioSeconds, mixSeconds, audioSeconds / mixSeconds,
+                1e9 * mixSeconds / voiceFrames,
+                voiceFrames / mixSeconds / AUDIO_SAMPLE_RATE );
+
+        // The same voices through SDL's audio thread
+        if ( !getenv( "SDL_AUDIODRIVER" ) )
+        {
+                SDL_setenv( "SDL_AUDIODRIVER", "dummy", 1 );
+        }
+        if ( openAudioMixer( mixer ) )
+        {
+                playBenchmarkVoices( mixer, sounds, 4, voiceCount );
+                const char* driver = SDL_GetCurrentAudioDriver();
+
+                SDL_Delay( 2000 );
+                closeAudioMixer( mixer );
+
+                AudioStats* stats = &mixer->stats;
+                real64 bufferSeconds = (real64)AUDIO_BUFFER_FRAMES / AUDIO_SAMPLE_RATE;
+                real64 meanSeconds = stats->callbacks ? stats->mixSeconds / stats->callbacks : 0;
+                printf( "  device (%s): %llu callbacks, mean %.3f ms, max %.3f ms, "
+                        "%.1f%% of the %.1f ms buffer, %llu voices dropped\n",
+                        driver ? driver : "?",
+                        (unsigned long long)stats->callbacks,
+                        1000.0 * meanSeconds, 1000.0 * stats->maxCallbackSeconds,
+                        100.0 * meanSeconds / bufferSeconds, 1000.0 * bufferSeconds,
+                        (unsigned long long)stats->droppedVoices );
+        }
+
+        free( output );
+        free( mixer );
+        for ( uint32 i = 0; i < 4; ++i )
+        {
+                freeSound( &sounds[i] );
+        }
+}
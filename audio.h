@@ -0,0 +1,102 @@
+// Audio
+
+#define AUDIO_SAMPLE_RATE 48000
+#define AUDIO_BUFFER_FRAMES 1024
+#define AUDIO_MAX_VOICES 512
+
+// Voices are mixed this many frames at a time into the mix buffers
+#define AUDIO_MIX_FRAMES 1024
+
+// Must be a power of two
+#define AUDIO_COMMAND_COUNT 1024
+
+// Mono float samples. The sample after the last one repeats the first,
+// so that interpolation can always read one sample ahead.
+struct Sound
+{
+        real32* samples;
+        uint32 frameCount;
+        real32 sampleRate;
+};
+
+enum AudioCommandType
+{
+        AudioCommand_Play,
+        AudioCommand_Stop,
+        AudioCommand_Change,
+        AudioCommand_StopAll,
+};
+
+struct AudioCommand
+{
+        uint32 type;
+        uint32 voiceId;
+        Sound* sound;
+        real32 volume;
+        real32 pan;   // -1 left to 1 right
+        real32 pitch;
+        bool32 loop;
+};
+
+// Single producer (the game thread), single consumer (the audio thread).
+// Each side only ever stores to its own index.
+struct AudioCommandRing
+{
+        AudioCommand commands[AUDIO_COMMAND_COUNT];
+        SDL_atomic_t writeIndex;
+        SDL_atomic_t readIndex;
+};
+
+struct AudioVoice
+{
+        uint32 id;
+        Sound* sound;
+        bool32 loop;
+
+        // Removed once it has faded out
+        bool32 stopping;
+
+        // Frames into the sound, 32.32 fixed point, and how far it moves
+        // every output frame
+        uint64 position;
+        uint64 step;
+
+        // Gains move to their targets over one mix buffer, so changes
+        // don't click
+        real32 gainLeft;
+        real32 gainRight;
+        real32 targetLeft;
+        real32 targetRight;
+};
+
+struct AudioStats
+{
+        uint64 framesMixed;
+        uint64 voiceFramesMixed;
+        uint64 callbacks;
+        uint64 droppedVoices;
+        real64 mixSeconds;
+        real64 maxCallbackSeconds;
+};
+
+struct AudioMixer
+{
+        SDL_AudioDeviceID device;
+        uint32 sampleRate;
+
+        AudioCommandRing commands;
+
+        // Game thread only
+        uint32 nextVoiceId;
+        uint32 droppedCommands;
+
+        // Audio thread only
+        AudioVoice voices[AUDIO_MAX_VOICES];
+        uint32 voiceCount;
+        real32 mixLeft[AUDIO_MIX_FRAMES];
+        real32 mixRight[AUDIO_MIX_FRAMES];
+        real32 fetchFrom[AUDIO_MIX_FRAMES];
+        real32 fetchTo[AUDIO_MIX_FRAMES];
+        real32 fetchT[AUDIO_MIX_FRAMES];
+        AudioStats stats;
+};
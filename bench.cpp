@@ -0,0 +1,657 @@
+// Benchmarks
+//
+// A separate build of the game (see bench.sh) that times the helpers the
+// game depends on, without opening a window. Every benchmark is run
+// until a sample takes long enough to measure, then sampled a few times;
+// the median is reported.
+//
+//     augen-bench [--json] [--filter name]
+//
+// --json prints one JSON object per line instead of a table, for
+// comparing runs over time.
+
+#define AUGEN_BENCHMARK
+#include "main.cpp"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#include <x86intrin.h>
+#define BENCHMARK_HAS_CYCLES 1
+#endif
+
+#include <algorithm>
+
+#define BENCHMARK_SAMPLES 7
+#define BENCHMARK_SAMPLE_SECONDS 0.02
+
+// Keeps the compiler from throwing away the work being timed
+global_variable volatile uint64 benchmarkSink;
+
+// Runs iterations operations, returns how many were done
+typedef uint64 BenchmarkProc( void* data, uint64 iterations );
+
+struct Benchmark
+{
+        bool32 json;
+        const char* filter;
+};
+
+struct BenchmarkResult
+{
+        uint64 iterations;
+        real64 nsPerOp;
+        real64 minNsPerOp;
+        real64 opsPerSecond;
+        real64 cyclesPerOp;
+};
+
+// Reference cycles (the time stamp counter), or 0 where there is none
+inline uint64
+readCycleCounter()
+{
+#if BENCHMARK_HAS_CYCLES
+        return __rdtsc();
+#else
+        return 0;
+#endif
+}
+
+internal BenchmarkResult
+measureBenchmark( BenchmarkProc* proc, void* data )
+{
+        // Grow the sample until it is long enough to time reliably
+        uint64 iterations = 1;
+        for ( ;; )
+        {
+                uint64 start = getPerformanceCounter();
+                proc( data, iterations );
+                real64 seconds = getSecondsElapsed( start, getPerformanceCounter() );
+                if ( seconds >= BENCHMARK_SAMPLE_SECONDS || iterations >= ((uint64)1 << 40) )
+                {
+                        break;
+                }
+                iterations *= seconds > 0.001 ? (uint64)(BENCHMARK_SAMPLE_SECONDS / seconds) + 1 : 10;
+        }
+
+        real64 nsPerOp[BENCHMARK_SAMPLES];
+        real64 cyclesPerOp[BENCHMARK_SAMPLES];
+        for ( uint32 sample = 0; sample < BENCHMARK_SAMPLES; ++sample )
+        {
+                uint64 startCycles = readCycleCounter();
+                uint64 start = getPerformanceCounter();
+                uint64 ops = proc( data, iterations );
+                uint64 end = getPerformanceCounter();
+                uint64 endCycles = readCycleCounter();
+
+                nsPerOp[sample] = 1e9 * getSecondsElapsed( start, end ) / ops;
+                cyclesPerOp[sample] = (real64)(endCycles - startCycles) / ops;
+        }
+        std::sort( nsPerOp, nsPerOp + BENCHMARK_SAMPLES );
+        std::sort( cyclesPerOp, cyclesPerOp + BENCHMARK_SAMPLES );
+
+        BenchmarkResult result;
+        result.iterations = iterations;
+        result.nsPerOp = nsPerOp[ BENCHMARK_SAMPLES / 2 ];
+        result.minNsPerOp = nsPerOp[0];
+        result.opsPerSecond = 1e9 / result.nsPerOp;
+        result.cyclesPerOp = cyclesPerOp[ BENCHMARK_SAMPLES / 2 ];
+        return result;
+}
+
+// size is whatever the benchmark scales with (tiles, voices...), or 0.
+// Returns all zeroes when the benchmark is filtered out.
+internal BenchmarkResult
+runBenchmark( Benchmark* bench, const char* name, int64 size,
+              BenchmarkProc* proc, void* data )
+{
+        BenchmarkResult result = {};
+        if ( bench->filter && !strstr( name, bench->filter ) )
+        {
+                return result;
+        }
+
+        result = measureBenchmark( proc, data );
+
+        if ( bench->json )
+        {
+                printf( "{\"name\":\"%s\",\"size\":%lld,\"lanes\":%d,\"iterations\":%llu,"
+                        "\"ns_per_op\":%.4f,\"min_ns_per_op\":%.4f,\"ops_per_second\":%.1f,"
+                        "\"cycles_per_op\":%.3f}\n",
+                        name, (long long)size, LANE_WIDTH, (unsigned long long)result.iterations,
+                        result.nsPerOp, result.minNsPerOp, result.opsPerSecond,
+                        result.cyclesPerOp );
+        }
+        else
+        {
+                printf( "%-28s %10lld %12.3f %12.3f %14.0f %10.2f\n",
+                        name, (long long)size, result.nsPerOp, result.minNsPerOp,
+                        result.opsPerSecond, result.cyclesPerOp );
+        }
+        fflush( stdout );
+        return result;
+}
+
+inline uint32
+nextRandom( uint32* state )
+{
+        // xorshift32
+        uint32 x = *state;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        *state = x;
+        return x;
+}
+
+inline real32
+randomBilateral( uint32* state )
+{
+        real32 result = (real32)(nextRandom( state ) >> 8) / 8388608.0f - 1.0f;
+        return result;
+}
+
+//
+// Positions and vectors
+//
+
+#define BENCHMARK_POSITIONS 4096
+
+struct PositionData
+{
+        World* world;
+        WorldPosition positions[BENCHMARK_POSITIONS];
+        WorldPosition others[BENCHMARK_POSITIONS];
+        V2 vectors[BENCHMARK_POSITIONS];
+
+        // The positions again, one array per field, for the lane versions
+        int32 tileX[BENCHMARK_POSITIONS];
+        int32 tileY[BENCHMARK_POSITIONS];
+        real32 relativeX[BENCHMARK_POSITIONS];
+        real32 relativeY[BENCHMARK_POSITIONS];
+};
+
+internal uint64
+benchRecanonicalizePosition( void* data, uint64 iterations )
+{
+        PositionData* d = (PositionData*)data;
+        uint64 sum = 0;
+        for ( uint64 i = 0; i < iterations; ++i )
+        {
+                WorldPosition pos = recanonicalizePosition( d->world, d->positions[ i & (BENCHMARK_POSITIONS - 1) ] );
+                sum += pos.tileX + pos.tileY;
+        }
+        benchmarkSink += sum;
+        return iterations;
+}
+
+internal uint64
+benchRecanonicalizeLanes( void* data, uint64 iterations )
+{
+        PositionData* d = (PositionData*)data;
+        LaneI32 sum = laneI32( 0 );
+        uint64 ops = 0;
+        for ( uint64 i = 0; i < iterations; i += LANE_WIDTH )
+        {
+                uint32 at = (uint32)(i & (BENCHMARK_POSITIONS - 1));
+                LaneWorldPosition pos;
+                pos.tileX = loadLaneI32( d->tileX + at );
+                pos.tileY = loadLaneI32( d->tileY + at );
+                pos.relative.x = loadLaneR32( d->relativeX + at );
+                pos.relative.y = loadLaneR32( d->relativeY + at );
+                pos = recanonicalizeLanes( d->world, pos );
+                sum += pos.tileX + pos.tileY;
+                ops += LANE_WIDTH;
+        }
+        benchmarkSink += getLane( sum, 0 );
+        return ops;
+}
+
+internal uint64
+benchV2Operators( void* data, uint64 iterations )
+{
+        PositionData* d = (PositionData*)data;
+        V2 sum = {};
+        uint64 count = 0;
+        for ( uint64 i = 0; i < iterations; ++i )
+        {
+                V2 a = d->vectors[ i & (BENCHMARK_POSITIONS - 1) ];
+                V2 b = d->vectors[ (i + 1) & (BENCHMARK_POSITIONS - 1) ];
+                V2 c = 2.0f * (a + b) - b;
+                if ( c > a )
+                {
+                        ++count;
+                }
+                sum += c;
+        }
+        benchmarkSink += count + (uint64)sum.x;
+        return iterations;
+}
+
+internal uint64
+benchV2LaneOperators( void* data, uint64 iterations )
+{
+        PositionData* d = (PositionData*)data;
+        LaneV2 sum = { laneR32( 0 ), laneR32( 0 ) };
+        LaneI32 count = laneI32( 0 );
+        uint64 ops = 0;
+        for ( uint64 i = 0; i < iterations; i += LANE_WIDTH )
+        {
+                uint32 at = (uint32)(i & (BENCHMARK_POSITIONS - 1));
+                uint32 next = (at + LANE_WIDTH) & (BENCHMARK_POSITIONS - 1);
+                LaneV2 a = { loadLaneR32( d->relativeX + at ), loadLaneR32( d->relativeY + at ) };
+                LaneV2 b = { loadLaneR32( d->relativeX + next ), loadLaneR32( d->relativeY + next ) };
+                LaneV2 c = 2.0f * (a + b) - b;
+                count += maskInt32( c > a, laneI32( 1 ) );
+                sum += c;
+                ops += LANE_WIDTH;
+        }
+        benchmarkSink += getLane( count, 0 ) + (uint64)getLane( sum.x, 0 );
+        return ops;
+}
+
+internal uint64
+benchWorldPositionOperators( void* data, uint64 iterations )
+{
+        PositionData* d = (PositionData*)data;
+        uint64 sum = 0;
+        for ( uint64 i = 0; i < iterations; ++i )
+        {
+                uint32 at = (uint32)(i & (BENCHMARK_POSITIONS - 1));
+                WorldPosition difference = d->positions[at] - d->others[at];
+                WorldPosition back = difference + d->others[at];
+                sum += difference.tileX + back.tileY;
+                if ( back > difference )
+                {
+                        ++sum;
+                }
+        }
+        benchmarkSink += sum;
+        return iterations;
+}
+
+//
+// Tile map queries
+//
+
+struct TileQueryData
+{
+        World* world;
+        WorldPosition* positions;
+        uint32 positionMask;
+};
+
+internal uint64
+benchGetTileValue( void* data, uint64 iterations )
+{
+        TileQueryData* d = (TileQueryData*)data;
+        uint64 sum = 0;
+        for ( uint64 i = 0; i < iterations; ++i )
+        {
+                sum += getTileValue( d->world, d->positions[ i & d->positionMask ] );
+        }
+        benchmarkSink += sum;
+        return iterations;
+}
+
+internal uint64
+benchIsTileEmpty( void* data, uint64 iterations )
+{
+        TileQueryData* d = (TileQueryData*)data;
+        uint64 sum = 0;
+        for ( uint64 i = 0; i < iterations; ++i )
+        {
+                sum += isTileEmpty( d->world, d->positions[ i & d->positionMask ] );
+        }
+        benchmarkSink += sum;
+        return iterations;
+}
+
+//
+// Game
+//
+
+#define BENCHMARK_PLAYERS 1024
+
+struct UpdatePlayerData
+{
+        GameState gameState;
+        Player players[BENCHMARK_PLAYERS];
+        GameInput inputs[BENCHMARK_PLAYERS];
+};
+
+internal uint64
+benchUpdatePlayer( void* data, uint64 iterations )
+{
+        UpdatePlayerData* d = (UpdatePlayerData*)data;
+        GameState gameState = d->gameState;
+        for ( uint64 i = 0; i < iterations; ++i )
+        {
+                uint32 at = (uint32)(i & (BENCHMARK_PLAYERS - 1));
+                gameState.player = d->players[at];
+                d->players[at] = updatePlayer( gameState, d->inputs[at], 1.0f / 60.0f );
+        }
+        benchmarkSink += d->players[0].position.tileX;
+        return iterations;
+}
+
+struct DrawData
+{
+        SDL_Renderer* renderer;
+        GameState gameState;
+};
+
+internal uint64
+benchDrawBackground( void* data, uint64 iterations )
+{
+        DrawData* d = (DrawData*)data;
+        for ( uint64 i = 0; i < iterations; ++i )
+        {
+                drawBackground( d->renderer, d->gameState );
+        }
+        return iterations;
+}
+
+// One op is one particle for one frame, so ops/s divided by 60 is how
+// many particles fit in a 60 Hz frame
+struct ParticleData
+{
+        SDL_Renderer* renderer;
+        World* world;
+        Camera camera;
+        ParticleSystem system;
+};
+
+internal uint64
+benchUpdateParticles( void* data, uint64 iterations )
+{
+        ParticleData* d = (ParticleData*)data;
+        uint64 ops = 0;
+        while ( ops < iterations )
+        {
+                // An empty system still counts, or the loop would never end
+                uint32 count = d->system.count;
+                updateParticles( &d->system, d->world, 1.0f / 60.0f );
+                ops += count ? count : 1;
+        }
+        return ops;
+}
+
+internal uint64
+benchParticleFrame( void* data, uint64 iterations )
+{
+        ParticleData* d = (ParticleData*)data;
+        uint64 ops = 0;
+        while ( ops < iterations )
+        {
+                uint32 count = d->system.count;
+                updateParticles( &d->system, d->world, 1.0f / 60.0f );
+                drawParticles( d->renderer, &d->system, d->world, d->camera );
+                ops += count ? count : 1;
+        }
+        return ops;
+}
+
+#define BENCHMARK_RAYS 4096
+
+struct RaycastData
+{
+        World* world;
+        RaycastWorkers* workers;
+        Ray rays[BENCHMARK_RAYS];
+        RayHit hits[BENCHMARK_RAYS];
+};
+
+internal uint64
+benchCastRays( void* data, uint64 iterations )
+{
+        RaycastData* d = (RaycastData*)data;
+        uint64 ops = 0;
+        while ( ops < iterations )
+        {
+                castRays( d->world, d->rays, d->hits, BENCHMARK_RAYS );
+                ops += BENCHMARK_RAYS;
+        }
+        benchmarkSink += d->hits[0].tileX;
+        return ops;
+}
+
+internal uint64
+benchCastRaysParallel( void* data, uint64 iterations )
+{
+        RaycastData* d = (RaycastData*)data;
+        uint64 ops = 0;
+        while ( ops < iterations )
+        {
+                castRaysParallel( d->workers, d->world, d->rays, d->hits, BENCHMARK_RAYS );
+                ops += BENCHMARK_RAYS;
+        }
+        benchmarkSink += d->hits[0].tileX;
+        return ops;
+}
+
+// Players spread over the empty tiles of a rooms map of size by size
+// tiles starting at origin, walking in random directions
+internal void
+placeBenchmarkPlayers( UpdatePlayerData* d, World* world, int64 origin, int32 size, uint32* random )
+{
+        for ( uint32 i = 0; i < BENCHMARK_PLAYERS; ++i )
+        {
+                Player player = {};
+                player.size = { 0.46875f * world->tileSideInMeters, 0.78125f * world->tileSideInMeters };
+                do
+                {
+                        player.position.tileX = origin + nextRandom( random ) % size;
+                        player.position.tileY = origin + nextRandom( random ) % size;
+                } while ( !isTileEmpty( world, player.position ) );
+
+                d->players[i] = player;
+                d->inputs[i].move = { (real32)(nextRandom( random ) % 3) - 1.0f,
+                                      (real32)(nextRandom( random ) % 3) - 1.0f };
+        }
+}
+
+int32 main( int32 argc, char** argv )
+{
+        Benchmark bench = {};
+        for ( int32 i = 1; i < argc; ++i )
+        {
+                if ( strcmp( argv[i], "--json" ) == 0 )
+                {
+                        bench.json = true;
+                }
+                else if ( strcmp( argv[i], "--filter" ) == 0 && i + 1 < argc )
+                {
+                        bench.filter = argv[++i];
+                }
+        }
+
+        if ( !bench.json )
+        {
+                printf( "%d lanes, %s cycles\n", LANE_WIDTH,
+                        readCycleCounter() ? "reference" : "no" );
+                printf( "%-28s %10s %12s %12s %14s %10s\n",
+                        "benchmark", "size", "ns/op", "min ns/op", "ops/s", "cycles/op" );
+        }
+
+        uint32 random = 0x12345678;
+
+        World world;
+        TileMap tileMap;
+        initializeRoomsWorld( &world, &tileMap, 256, 256 );
+
+        PositionData* positions = (PositionData*)calloc( 1, sizeof(PositionData) );
+        positions->world = &world;
+        for ( uint32 i = 0; i < BENCHMARK_POSITIONS; ++i )
+        {
+                // Mostly within a tile or two of canonical, like the
+                // offsets the game produces
+                WorldPosition pos;
+                pos.tileX = nextRandom( &random ) % 256;
+                pos.tileY = nextRandom( &random ) % 256;
+                pos.relative = { 2.0f * world.tileSideInMeters * randomBilateral( &random ),
+                                 2.0f * world.tileSideInMeters * randomBilateral( &random ) };
+                positions->positions[i] = pos;
+                positions->others[ (i * 7) & (BENCHMARK_POSITIONS - 1) ] = pos;
+                positions->vectors[i] = pos.relative;
+
+                positions->tileX[i] = pos.tileX;
+                positions->tileY[i] = pos.tileY;
+                positions->relativeX[i] = pos.relative.x;
+                positions->relativeY[i] = pos.relative.y;
+        }
+
+        runBenchmark( &bench, "recanonicalizePosition", 0, benchRecanonicalizePosition, positions );
+        runBenchmark( &bench, "recanonicalizeLanes", 0, benchRecanonicalizeLanes, positions );
+        runBenchmark( &bench, "V2 operators", 0, benchV2Operators, positions );
+        runBenchmark( &bench, "V2 lane operators", 0, benchV2LaneOperators, positions );
+        runBenchmark( &bench, "WorldPosition operators", 0, benchWorldPositionOperators, positions );
+
+        // Drawing, into a surface instead of a window
+        SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat( 0, SCREEN_WIDTH, SCREEN_HEIGHT,
+                                                               32, SDL_PIXELFORMAT_ARGB8888 );
+        SDL_Renderer* renderer = surface ? SDL_CreateSoftwareRenderer( surface ) : 0;
+        if ( renderer )
+        {
+                DrawData draw = {};
+                draw.renderer = renderer;
+                draw.gameState.world = &world;
+                draw.gameState.player.position.tileX = 128;
+                draw.gameState.player.position.tileY = 128;
+                draw.gameState.camera.size = { SCREEN_WIDTH / world.tileSideInPixels + 1,
+                                               SCREEN_HEIGHT / world.tileSideInPixels + 1 };
+                draw.gameState.camera = updateCamera( draw.gameState );
+
+                int64 tilesDrawn = (int64)(draw.gameState.camera.size.x + 1) * (int64)(draw.gameState.camera.size.y + 1);
+                runBenchmark( &bench, "drawBackground", tilesDrawn, benchDrawBackground, &draw );
+
+                // Particles that never expire or slow down, bouncing
+                // around the rooms on screen and a screen beyond
+                ParticleData* particles = (ParticleData*)calloc( 1, sizeof(ParticleData) );
+                particles->renderer = renderer;
+                particles->world = &world;
+                particles->camera = draw.gameState.camera;
+                uint32 particleCounts[] = { 1 << 10, 1 << 14, 1 << 16, 1 << 18 };
+                for ( uint32 countIndex = 0; countIndex < sizeof(particleCounts) / sizeof(particleCounts[0]); ++countIndex )
+                {
+                        uint32 count = particleCounts[countIndex];
+                        initializeParticleSystem( &particles->system, count );
+                        particles->system.drag = 0.0f;
+                        while ( particles->system.count < count )
+                        {
+                                WorldPosition pos = draw.gameState.player.position;
+                                pos.tileX += (int32)(nextRandom( &random ) % 32) - 16;
+                                pos.tileY += (int32)(nextRandom( &random ) % 24) - 12;
+                                if ( isTileEmpty( &world, pos ) )
+                                {
+                                        emitParticleBurst( &particles->system, pos, 1, 4.0f, 1e9f );
+                                }
+                        }
+
+                        runBenchmark( &bench, "updateParticles", count, benchUpdateParticles, particles );
+                        BenchmarkResult frame = runBenchmark( &bench, "particle frame", count,
+                                                              benchParticleFrame, particles );
+                        if ( frame.iterations && !bench.json )
+                        {
+                                printf( "%-28s %10u %12.0f particles per frame at 60 Hz\n",
+                                        "", count, frame.opsPerSecond / 60.0 );
+                        }
+                        freeParticleSystem( &particles->system );
+                }
+                free( particles );
+
+                SDL_DestroyRenderer( renderer );
+        }
+        else
+        {
+                printf( "Software renderer could not be created. SDL_Error: %s\n", SDL_GetError() );
+        }
+        SDL_FreeSurface( surface );
+        freeTileMap( &tileMap );
+
+        // Queries and updates over growing maps, to show where the tiles
+        // stop fitting in cache
+        const uint32 QUERY_POSITIONS = 1 << 16;
+        WorldPosition* queries = (WorldPosition*)malloc( QUERY_POSITIONS * sizeof(WorldPosition) );
+        UpdatePlayerData* players = (UpdatePlayerData*)calloc( 1, sizeof(UpdatePlayerData) );
+
+        int32 sizes[] = { 64, 256, 1024, 4096 };
+        for ( uint32 sizeIndex = 0; sizeIndex < sizeof(sizes) / sizeof(sizes[0]); ++sizeIndex )
+        {
+                int32 size = sizes[sizeIndex];
+                initializeRoomsWorld( &world, &tileMap, size, size );
+                int64 tileCount = (int64)size * size;
+
+                // A few out of bounds, which take the early return
+                for ( uint32 i = 0; i < QUERY_POSITIONS; ++i )
+                {
+                        queries[i].tileX = (int32)(nextRandom( &random ) % (size + 2)) - 1;
+                        queries[i].tileY = (int32)(nextRandom( &random ) % (size + 2)) - 1;
+                        queries[i].relative = {};
+                }
+                TileQueryData query = { &world, queries, QUERY_POSITIONS - 1 };
+                runBenchmark( &bench, "getTileValue", tileCount, benchGetTileValue, &query );
+                runBenchmark( &bench, "isTileEmpty", tileCount, benchIsTileEmpty, &query );
+
+                players->gameState.world = &world;
+                placeBenchmarkPlayers( players, &world, 0, size, &random );
+                runBenchmark( &bench, "updatePlayer", tileCount, benchUpdatePlayer, players );
+
+                freeTileMap( &tileMap );
+        }
+
+        // Rays from empty tiles in every direction, up to 32 meters
+        initializeRoomsWorld( &world, &tileMap, 1024, 1024 );
+        RaycastWorkers workers = {};
+        startRaycastWorkers( &workers, 0 );
+        RaycastData* raycast = (RaycastData*)calloc( 1, sizeof(RaycastData) );
+        raycast->world = &world;
+        raycast->workers = &workers;
+        for ( uint32 i = 0; i < BENCHMARK_RAYS; ++i )
+        {
+                Ray* ray = &raycast->rays[i];
+                do
+                {
+                        ray->origin.tileX = nextRandom( &random ) % 1024;
+                        ray->origin.tileY = nextRandom( &random ) % 1024;
+                } while ( !isTileEmpty( &world, ray->origin ) );
+                ray->origin.relative = { 0.5f * world.tileSideInMeters * randomBilateral( &random ),
+                                         0.5f * world.tileSideInMeters * randomBilateral( &random ) };
+                ray->direction = { randomBilateral( &random ), randomBilateral( &random ) };
+                ray->maxDistance = 32.0f;
+        }
+        runBenchmark( &bench, "castRays", BENCHMARK_RAYS, benchCastRays, raycast );
+        runBenchmark( &bench, "castRaysParallel", workers.threadCount + 1, benchCastRaysParallel, raycast );
+        freeTileMap( &tileMap );
+
+        // The same rooms FAR_TILE_OFFSET tiles out, which should cost the
+        // same as near the origin
+        initializeTileMap( &world, &tileMap, 4 );
+        buildRooms( &world, FAR_TILE_OFFSET, FAR_TILE_OFFSET, 1024, 1024 );
+        for ( uint32 i = 0; i < QUERY_POSITIONS; ++i )
+        {
+                queries[i].tileX = FAR_TILE_OFFSET + nextRandom( &random ) % 1024;
+                queries[i].tileY = FAR_TILE_OFFSET + nextRandom( &random ) % 1024;
+                queries[i].relative = {};
+        }
+        TileQueryData farQuery = { &world, queries, QUERY_POSITIONS - 1 };
+        runBenchmark( &bench, "getTileValue far", 1024 * 1024, benchGetTileValue, &farQuery );
+
+        players->gameState.world = &world;
+        placeBenchmarkPlayers( players, &world, FAR_TILE_OFFSET, 1024, &random );
+        runBenchmark( &bench, "updatePlayer far", 1024 * 1024, benchUpdatePlayer, players );
+
+        for ( uint32 i = 0; i < BENCHMARK_RAYS; ++i )
+        {
+                raycast->rays[i].origin.tileX += FAR_TILE_OFFSET;
+                raycast->rays[i].origin.tileY += FAR_TILE_OFFSET;
+        }
+        runBenchmark( &bench, "castRays far", BENCHMARK_RAYS, benchCastRays, raycast );
+        stopRaycastWorkers( &workers );
+        free( raycast );
+        freeTileMap( &tileMap );
+
+        free( players );
+        free( queries );
+        free( positions );
+
+        return 0;
+}
@@ -0,0 +1,3 @@
+#!/bin/bash
+
+c++ bench.cpp -O2 -g -std=c++11 `pkg-config --cflags --libs sdl2` -o dist/build/augen-bench
@@ -1,36 +1,42 @@
 #include "main.h"
 #include "intrinsics.h"
+#include "simd.h"
 #include "sdl.h"
+#include "snapshot.h"
+#include "rewind.h"
+#include "net.h"
+#include "audio.h"
+#include "raycast.h"
+#include "particles.h"
 
 const real32 TILE_SIZE = 64.0f;
 
+const char* SNAPSHOT_BASE_PATH = "augen.snapshot";
+const char* SNAPSHOT_DELTA_PATH = "augen.snapshot.delta";
+
+// Far enough out that a tile coordinate in meters doesn't fit in a float
+const int64 FAR_TILE_OFFSET = 1000000000;
+
+const uint32 REWIND_SECONDS = 10;
+const uint64 REWIND_MEMORY_BUDGET = 64 * 1024 * 1024;
+
 internal WorldPosition
 recanonicalizePosition(World* world, WorldPosition pos)
 {
         real32 tileSize = world->tileSideInMeters;
         real32 tileRadius = tileSize / 2;
         
-        if (pos.relative.x < -tileRadius)
+        // Move by however many whole tiles put relative back within
+        // half a tile of the center
+        if (pos.relative.x < -tileRadius || pos.relative.x >= tileRadius)
         {
-                int32 tileOffset = floorReal32ToInt32(pos.relative.x / tileSize);
+                int32 tileOffset = floorReal32ToInt32((pos.relative.x + tileRadius) / tileSize);
                 pos.tileX += tileOffset;
                 pos.relative.x -= tileSize * tileOffset;
         }
-        if (pos.relative.x >= tileRadius)
-        {
-                int32 tileOffset = floorReal32ToInt32(pos.relative.x / tileSize) + 1;
-                pos.tileX += tileOffset;
-                pos.relative.x -= tileSize * tileOffset;
-        }
-        if (pos.relative.y < -tileRadius)
-        {
-                int32 tileOffset = floorReal32ToInt32(pos.relative.y / tileSize);
-                pos.tileY += tileOffset;
-                pos.relative.y -= tileSize * tileOffset;
-        }
-        if (pos.relative.y >= tileRadius)
+        if (pos.relative.y < -tileRadius || pos.relative.y >= tileRadius)
         {
-                int32 tileOffset = floorReal32ToInt32(pos.relative.y / tileSize) + 1;
+                int32 tileOffset = floorReal32ToInt32((pos.relative.y + tileRadius) / tileSize);
                 pos.tileY += tileOffset;
                 pos.relative.y -= tileSize * tileOffset;
         }
@@ -38,19 +44,282 @@ recanonicalizePosition(World* world, WorldPosition pos)
         return pos;
 }
 
+// One axis of recanonicalizePosition for every lane, masked instead of
+// branched on so that each lane gets exactly the scalar result
+inline void
+recanonicalizeLaneAxis(LaneR32 tileSize, LaneI32* tile, LaneR32* relative)
+{
+        LaneR32 tileRadius = 0.5f * tileSize;
+
+        LaneMask outside = (*relative < -tileRadius) | (*relative >= tileRadius);
+        LaneI32 tileOffset = maskInt32(outside, floorReal32ToInt32((*relative + tileRadius) / tileSize));
+        *tile += tileOffset;
+        *relative -= tileSize * convertToReal32(tileOffset);
+}
+
+internal LaneWorldPosition
+recanonicalizeLanes(World* world, LaneWorldPosition pos)
+{
+        LaneR32 tileSize = laneR32(world->tileSideInMeters);
+
+        recanonicalizeLaneAxis(tileSize, &pos.tileX, &pos.relative.x);
+        recanonicalizeLaneAxis(tileSize, &pos.tileY, &pos.relative.y);
+
+        return pos;
+}
+
+inline TileChunkPosition
+getChunkPositionFor(TileMap* tileMap, int64 absTileX, int64 absTileY)
+{
+        TileChunkPosition result;
+
+        result.tileChunkX = absTileX >> tileMap->chunkShift;
+        result.tileChunkY = absTileY >> tileMap->chunkShift;
+        result.tileX = (uint32)absTileX & tileMap->chunkMask;
+        result.tileY = (uint32)absTileY & tileMap->chunkMask;
+
+        return result;
+}
+
+inline uint32
+hashTileChunkPosition(int64 tileChunkX, int64 tileChunkY)
+{
+        uint64 hash = (uint64)tileChunkX * 0x9E3779B97F4A7C15ULL + (uint64)tileChunkY * 0xC2B2AE3D27D4EB4FULL;
+        uint32 result = (uint32)(hash ^ (hash >> 32));
+        return result;
+}
+
+// Returns the slot chunk coordinates are in, or the empty slot they
+// would go in
+inline uint32*
+findTileChunkSlot(TileMap* tileMap, int64 tileChunkX, int64 tileChunkY)
+{
+        uint32 mask = tileMap->chunkHashCapacity - 1;
+        uint32 slot = hashTileChunkPosition(tileChunkX, tileChunkY) & mask;
+        for (;;)
+        {
+                uint32 entry = tileMap->chunkHash[slot];
+                if (entry == 0)
+                {
+                        break;
+                }
+                TileChunk* tileChunk = &tileMap->tileChunks[entry - 1];
+                if (tileChunk->chunkX == tileChunkX && tileChunk->chunkY == tileChunkY)
+                {
+                        break;
+                }
+                slot = (slot + 1) & mask;
+        }
+        return &tileMap->chunkHash[slot];
+}
+
+// Null if no tile of the chunk has been set
+inline TileChunk*
+getTileChunk(TileMap* tileMap, int64 tileChunkX, int64 tileChunkY)
+{
+        TileChunk* tileChunk = 0;
+        uint32 entry = *findTileChunkSlot(tileMap, tileChunkX, tileChunkY);
+        if (entry)
+        {
+                tileChunk = &tileMap->tileChunks[entry - 1];
+        }
+        return tileChunk;
+}
+
+// Tiles and their reference count share one allocation
+internal TileChunk
+allocateTileChunk(TileMap* tileMap, int64 tileChunkX, int64 tileChunkY)
+{
+        uint32 chunkTileCount = tileMap->chunkDim * tileMap->chunkDim;
+        int32* block = (int32*)calloc( 1 + chunkTileCount, sizeof(uint32) );
+
+        TileChunk result;
+        result.chunkX = tileChunkX;
+        result.chunkY = tileChunkY;
+        result.refCount = block;
+        result.tiles = (uint32*)(block + 1);
+        *result.refCount = 1;
+
+        return result;
+}
+
+inline void
+retainTileChunk(TileChunk tileChunk)
+{
+        ++*tileChunk.refCount;
+}
+
+inline void
+releaseTileChunk(TileChunk tileChunk)
+{
+        if (--*tileChunk.refCount == 0)
+        {
+                free( tileChunk.refCount );
+        }
+}
+
+// Point dest at source, keeping reference counts balanced
+inline void
+replaceTileChunk(TileChunk* dest, TileChunk source)
+{
+        retainTileChunk(source);
+        releaseTileChunk(*dest);
+        *dest = source;
+}
+
+internal void
+markTileChunkDirty(TileMap* tileMap, uint32 chunkIndex)
+{
+        TileChunkList* list = tileMap->dirtyChunks;
+        if (list)
+        {
+                if (list->count == list->capacity)
+                {
+                        list->capacity = list->capacity ? 2 * list->capacity : 64;
+                        list->chunkIndices = (uint32*)realloc( list->chunkIndices,
+                                                               list->capacity * sizeof(uint32) );
+                }
+                list->chunkIndices[list->count++] = chunkIndex;
+        }
+}
+
+// Give tileChunk, which must be in tileMap->tileChunks, tiles of its
+// own before they are written
+internal void
+makeTileChunkWritable(TileMap* tileMap, TileChunk* tileChunk)
+{
+        if (*tileChunk->refCount > 1)
+        {
+                TileChunk copy = allocateTileChunk(tileMap, tileChunk->chunkX, tileChunk->chunkY);
+                memcpy( copy.tiles, tileChunk->tiles,
+                        tileMap->chunkDim * tileMap->chunkDim * sizeof(uint32) );
+                releaseTileChunk(*tileChunk);
+                *tileChunk = copy;
+                markTileChunkDirty(tileMap, (uint32)(tileChunk - tileMap->tileChunks));
+        }
+}
+
+// Rebuild the hash at newCapacity slots, which must be a power of two
+internal void
+resizeTileChunkHash(TileMap* tileMap, uint32 newCapacity)
+{
+        free( tileMap->chunkHash );
+        tileMap->chunkHashCapacity = newCapacity;
+        tileMap->chunkHash = (uint32*)calloc( newCapacity, sizeof(uint32) );
+        for (uint32 chunkIndex = 0; chunkIndex < tileMap->tileChunkCount; ++chunkIndex)
+        {
+                TileChunk* tileChunk = &tileMap->tileChunks[chunkIndex];
+                *findTileChunkSlot(tileMap, tileChunk->chunkX, tileChunk->chunkY) = chunkIndex + 1;
+        }
+}
+
+// Create the chunk if it doesn't exist yet, with every tile unset (2).
+// Pointers into tileChunks don't survive a call that creates a chunk.
+internal TileChunk*
+getOrCreateTileChunk(TileMap* tileMap, int64 tileChunkX, int64 tileChunkY)
+{
+        uint32* slot = findTileChunkSlot(tileMap, tileChunkX, tileChunkY);
+        if (*slot)
+        {
+                return &tileMap->tileChunks[*slot - 1];
+        }
+
+        if (tileMap->tileChunkCount == tileMap->tileChunkCapacity)
+        {
+                tileMap->tileChunkCapacity = tileMap->tileChunkCapacity ? 2 * tileMap->tileChunkCapacity : 64;
+                tileMap->tileChunks = (TileChunk*)realloc( tileMap->tileChunks,
+                                                           tileMap->tileChunkCapacity * sizeof(TileChunk) );
+        }
+
+        uint32 chunkIndex = tileMap->tileChunkCount++;
+        TileChunk* tileChunk = &tileMap->tileChunks[chunkIndex];
+        *tileChunk = allocateTileChunk(tileMap, tileChunkX, tileChunkY);
+        uint32 chunkTileCount = tileMap->chunkDim * tileMap->chunkDim;
+        for (uint32 tileIndex = 0; tileIndex < chunkTileCount; ++tileIndex)
+        {
+                tileChunk->tiles[tileIndex] = 2;
+        }
+        *slot = chunkIndex + 1;
+        markTileChunkDirty(tileMap, chunkIndex);
+
+        // Keep the hash at most half full
+        if (2 * tileMap->tileChunkCount > tileMap->chunkHashCapacity)
+        {
+                resizeTileChunkHash(tileMap, 2 * tileMap->chunkHashCapacity);
+        }
+
+        return tileChunk;
+}
+
+// Start an empty map. Chunks are created as their tiles are set.
+internal void
+initializeTileMap(World* world, TileMap* tileMap, uint32 chunkShift)
+{
+        *tileMap = {};
+        tileMap->chunkShift = chunkShift;
+        tileMap->chunkDim = 1 << chunkShift;
+        tileMap->chunkMask = tileMap->chunkDim - 1;
+        resizeTileChunkHash(tileMap, 64);
+
+        world->tileMap = tileMap;
+}
+
+internal void
+freeTileMap(TileMap* tileMap)
+{
+        for (uint32 chunkIndex = 0; chunkIndex < tileMap->tileChunkCount; ++chunkIndex)
+        {
+                releaseTileChunk(tileMap->tileChunks[chunkIndex]);
+        }
+        free( tileMap->tileChunks );
+        free( tileMap->chunkHash );
+        tileMap->tileChunks = 0;
+        tileMap->chunkHash = 0;
+        tileMap->tileChunkCount = 0;
+        tileMap->tileChunkCapacity = 0;
+}
+
+// Make dest a copy of source that shares its chunks until either writes
+internal void
+copyTileMap(TileMap* dest, TileMap* source)
+{
+        *dest = *source;
+        dest->tileChunks = (TileChunk*)malloc( source->tileChunkCapacity * sizeof(TileChunk) );
+        dest->chunkHash = (uint32*)malloc( source->chunkHashCapacity * sizeof(uint32) );
+        memcpy( dest->tileChunks, source->tileChunks, source->tileChunkCount * sizeof(TileChunk) );
+        memcpy( dest->chunkHash, source->chunkHash, source->chunkHashCapacity * sizeof(uint32) );
+        for (uint32 chunkIndex = 0; chunkIndex < dest->tileChunkCount; ++chunkIndex)
+        {
+                retainTileChunk(dest->tileChunks[chunkIndex]);
+        }
+        dest->dirtyChunks = 0;
+}
+
 internal uint32
 getTileValue(World* world, WorldPosition pos)
 {
-        if ((pos.tileX < 0 || pos.tileX >= world->tileCountX) ||
-            (pos.tileY < 0 || pos.tileY >= world->tileCountY))
+        TileMap* tileMap = world->tileMap;
+        TileChunkPosition chunkPos = getChunkPositionFor(tileMap, pos.tileX, pos.tileY);
+        TileChunk* tileChunk = getTileChunk(tileMap, chunkPos.tileChunkX, chunkPos.tileChunkY);
+        if (!tileChunk)
         {
-                // Invalid position. Out of bounds.
+                // Nothing has been built here
                 return 2;
         }
-        uint32 tileValue = world->tileMap->tiles[ pos.tileY * world->tileCountX + pos.tileX ];
+        uint32 tileValue = tileChunk->tiles[ chunkPos.tileY * tileMap->chunkDim + chunkPos.tileX ];
         return tileValue;
 }
 
+internal void
+setTileValue(World* world, int64 absTileX, int64 absTileY, uint32 tileValue)
+{
+        TileMap* tileMap = world->tileMap;
+        TileChunkPosition chunkPos = getChunkPositionFor(tileMap, absTileX, absTileY);
+        TileChunk* tileChunk = getOrCreateTileChunk(tileMap, chunkPos.tileChunkX, chunkPos.tileChunkY);
+        makeTileChunkWritable(tileMap, tileChunk);
+        tileChunk->tiles[ chunkPos.tileY * tileMap->chunkDim + chunkPos.tileX ] = tileValue;
+}
+
 internal bool32
 isTileEmpty(World* world, WorldPosition pos)
 {
@@ -64,14 +333,29 @@ isTileEmpty(World* world, WorldPosition pos)
         return isEmpty;
 }
 
+// a - b in meters. The tile difference is taken in integers before it
+// is converted, so the result is as precise as the two positions are
+// close, wherever they are in the world.
+inline V2
+subtractPositions(World* world, WorldPosition a, WorldPosition b)
+{
+        real32 tileSize = world->tileSideInMeters;
+        V2 result = {
+                tileSize * (real32)(a.tileX - b.tileX) + (a.relative.x - b.relative.x),
+                tileSize * (real32)(a.tileY - b.tileY) + (a.relative.y - b.relative.y)
+        };
+        return result;
+}
+
+// Where pos is on screen, with the camera position at the bottom left
 internal V2
-getScreenCoordinates(World* world, WorldPosition pos)
+getScreenCoordinates(World* world, WorldPosition pos, WorldPosition camera)
 {
-        real32 tileSize = world->tileSideInPixels;
+        V2 offset = world->metersToPixels * subtractPositions(world, pos, camera);
         real32 offsetForRightHandCoordinates = SCREEN_HEIGHT;
         V2 screenCoordinates = {
-                tileSize * pos.tileX + pos.relative.x * world->metersToPixels,
-                offsetForRightHandCoordinates - (tileSize * pos.tileY + pos.relative.y * world->metersToPixels)
+                offset.x,
+                offsetForRightHandCoordinates - offset.y
         };
         return screenCoordinates;
 }
@@ -98,9 +382,7 @@ updateCamera( GameState gameState )
         // Scroll by a fixed amount (full screen size)
         else if ( scrollingType == 1 )
         {
-                WorldPosition differenceInPosition = player.position - camera.position;
-                differenceInPosition = recanonicalizePosition(gameState.world, differenceInPosition);
-                V2 origin = getScreenCoordinates(gameState.world, differenceInPosition);
+                V2 origin = getScreenCoordinates(gameState.world, player.position, camera.position);
                 
                 if (origin.x > screenSize.x)
                 {
@@ -126,42 +408,15 @@ updateCamera( GameState gameState )
 }
 
 internal Player
-updatePlayer( GameState gameState, real32 dt )
+updatePlayer( GameState gameState, GameInput input, real32 dt )
 {
         World* world = gameState.world;
         Player player = gameState.player;
         uint32 tileSize = world->tileSideInMeters;
         
         const real32 VELOCITY_CONSTANT = 0.7071067811865476;
-        const uint8* keystate = SDL_GetKeyboardState( NULL );
-
-        V2 dPlayer = { 0.0f ,0.0f };
-
-        if ( keystate[ SDL_SCANCODE_W ] ) // Up
-        {
-                dPlayer.y += 1.0f;
-        }
-        if ( keystate[ SDL_SCANCODE_S ] ) // Down
-        {
-                dPlayer.y += -1.0f;
-        }
-        if ( keystate[ SDL_SCANCODE_A ] ) // Left
-        {
-                dPlayer.x += -1.0f;
-        }
-        if ( keystate[ SDL_SCANCODE_D ] ) // Right
-        {
-                dPlayer.x += 1.0f;
-        }
 
-        // if ( keystate[ SDL_SCANCODE_UP ] ) // Zoom in
-        // {
-        //         world->tileSideInPixels += 1.0f;
-        // }
-        // if ( keystate[ SDL_SCANCODE_DOWN ] ) // Zoom out
-        // {
-        //         world->tileSideInPixels -= 1.0f;
-        // }
+        V2 dPlayer = input.move;
 
         real32 speed = 4.0;
         dPlayer = speed * dPlayer;
@@ -205,10 +460,11 @@ updatePlayer( GameState gameState, real32 dt )
 // Update game state
 internal GameState
 updateGame( const GameState oldGameState,
+            GameInput input,
             real32 dt )
 {
         // Update player
-        Player player = updatePlayer(oldGameState, dt);
+        Player player = updatePlayer(oldGameState, input, dt);
 
         // Adjust camera
         Camera camera = updateCamera(oldGameState);
@@ -273,12 +529,12 @@ drawBackground( SDL_Renderer*   renderer,
         // }
 
 
-        int32 cameraMaxY = camera.position.tileY + camera.size.y;
-        int32 cameraMaxX = camera.position.tileX + camera.size.x;
+        int64 cameraMaxY = camera.position.tileY + (int64)camera.size.y;
+        int64 cameraMaxX = camera.position.tileX + (int64)camera.size.x;
         
-        for (int32 row = camera.position.tileY - 1; row < cameraMaxY; ++row)
+        for (int64 row = camera.position.tileY - 1; row < cameraMaxY; ++row)
         {
-                for (int32 col = camera.position.tileX - 1; col < cameraMaxX; ++col)
+                for (int64 col = camera.position.tileX - 1; col < cameraMaxX; ++col)
                 {
                         WorldPosition testPosition;
                         testPosition.tileX = col;
@@ -308,9 +564,7 @@ drawBackground( SDL_Renderer*   renderer,
                         V2 screenSize = { SCREEN_WIDTH, SCREEN_HEIGHT };
                         real32 tileSize = world->tileSideInPixels;
                         V2 size = { tileSize, tileSize };
-                        WorldPosition differenceInPosition = testPosition - camera.position;
-                        differenceInPosition = recanonicalizePosition(world, differenceInPosition);
-                        V2 origin = getScreenCoordinates(world, differenceInPosition);
+                        V2 origin = getScreenCoordinates(world, testPosition, camera.position);
                         origin.y -= tileSize; // to account for flipped y-coordinate
 
                         if ( origin > (-1)*size && origin < screenSize)
@@ -325,7 +579,8 @@ drawBackground( SDL_Renderer*   renderer,
 
 // Draw to the screen
 internal void
-draw( SDL_Window* window, SDL_Renderer* renderer, const GameState gameState )
+draw( SDL_Window* window, SDL_Renderer* renderer, const GameState gameState,
+      ParticleSystem* particles )
 {
         Player player = gameState.player;
         Camera camera = gameState.camera;
@@ -335,6 +590,8 @@ draw( SDL_Window* window, SDL_Renderer* renderer, const GameState gameState )
         SDL_RenderClear( renderer );
 
         drawBackground( renderer, gameState );
+
+        drawParticles( renderer, particles, gameState.world, camera );
         
         // Draw player
         real32 tileRadius = gameState.world->tileSideInMeters / 2;
@@ -342,9 +599,7 @@ draw( SDL_Window* window, SDL_Renderer* renderer, const GameState gameState )
         V2 playerCenter = { player.size.x / 2, -player.size.y }; // negate player height for flipped y-coordinate
         player.position.relative = player.position.relative - playerCenter + offsetForCenterOfTile;
 
-        WorldPosition differenceInPosition = player.position - camera.position;
-        differenceInPosition = recanonicalizePosition(gameState.world, differenceInPosition);
-        V2 origin = getScreenCoordinates(gameState.world, differenceInPosition);
+        V2 origin = getScreenCoordinates(gameState.world, player.position, camera.position);
         V2 size = gameState.world->metersToPixels * player.size;
         
         drawRectangle( renderer, origin, size, 1.0, 1.0, 0.0, 1.0 );
@@ -353,32 +608,45 @@ draw( SDL_Window* window, SDL_Renderer* renderer, const GameState gameState )
         SDL_RenderPresent( renderer );
 }
 
-int32 main( int32 argc, char** argv )
+// 12x12 rooms with doorways, with their lower left corner at the origin
+// tile
+internal void
+buildRooms( World* world, int64 originTileX, int64 originTileY,
+            int32 tileCountX, int32 tileCountY )
 {
-        // Initialize SDL and create window
-        SDL_Window* window = initializeSDL();
-        if ( window == NULL )
+        for (int32 row = 0; row < tileCountY; ++row)
         {
-                printf( "Window could not be created. SDL_Error: %s\n",
-                        SDL_GetError() );
-                return 0;
+                for (int32 col = 0; col < tileCountX; ++col)
+                {
+                        bool32 wall = ((col % 12 == 0 && row % 12 != 6) ||
+                                       (row % 12 == 0 && col % 12 != 6));
+                        setTileValue( world, originTileX + col, originTileY + row, wall ? 1 : 0 );
+                }
         }
+}
 
-        // Create Renderer
-        SDL_Renderer* renderer = createRenderer( window );
-        if( renderer == NULL )
-        {
-                printf( "Renderer could not be created. SDL Error: %s\n",
-                        SDL_GetError() );
-                return 0;
-        }
+// A synthetic world of rooms, for benchmarks
+internal void
+initializeRoomsWorld( World* world, TileMap* tileMap, int32 tileCountX, int32 tileCountY )
+{
+        *world = {};
+        world->tileSideInMeters = 1.4f;
+        world->tileSideInPixels = TILE_SIZE;
+        world->metersToPixels = world->tileSideInPixels / world->tileSideInMeters;
+
+        initializeTileMap( world, tileMap, 4 );
+        buildRooms( world, 0, 0, tileCountX, tileCountY );
+}
 
+// Set the tiles of the starting map, with its lower left corner at the
+// origin tile
+internal void
+buildStartingMap( World* world, int64 originTileX, int64 originTileY )
+{
         // Tilemap
         const uint32 TILE_MAP_ROWS = 24;
         const uint32 TILE_MAP_COLS = 32;
 
-        printf("before tempTiles");
-        
         uint32 tempTiles[TILE_MAP_ROWS][TILE_MAP_COLS] = {
                 
                 { 1, 1, 1, 1,  1, 1, 1, 1,  1, 1, 1, 1,  1, 1, 1, 1,  1, 1, 1, 1,  1, 1, 1, 1,  1, 1, 1, 1,  1, 1, 1, 1 },
@@ -407,33 +675,319 @@ int32 main( int32 argc, char** argv )
                 { 1, 1, 1, 1,  1, 1, 1, 1,  1, 1, 1, 1,  1, 1, 1, 1,  1, 1, 1, 1,  1, 1, 1, 1,  1, 1, 1, 1,  1, 1, 1, 1 }
         };
 
-        TileMap tempTileMap;
-        tempTileMap.tiles = (uint32*)tempTiles;
-        
-        World world;
-        world.tileSideInMeters = 1.4f;
-        world.tileSideInPixels = TILE_SIZE;
-        world.metersToPixels = world.tileSideInPixels / world.tileSideInMeters;
-        world.tileMap = &tempTileMap;
-        world.tileCountX = TILE_MAP_COLS;
-        world.tileCountY = TILE_MAP_ROWS;
-        
+        for (uint32 row = 0; row < TILE_MAP_ROWS; ++row)
+        {
+                for (uint32 col = 0; col < TILE_MAP_COLS; ++col)
+                {
+                        setTileValue( world, originTileX + col, originTileY + row, tempTiles[row][col] );
+                }
+        }
+}
+
+// Build the starting map and place the player and camera in it
+internal GameState
+initializeGameState( World* world, TileMap* tileMap )
+{
+        world->tileSideInMeters = 1.4f;
+        world->tileSideInPixels = TILE_SIZE;
+        world->metersToPixels = world->tileSideInPixels / world->tileSideInMeters;
+        initializeTileMap( world, tileMap, 4 );
+        buildStartingMap( world, 0, 0 );
+
         Player player;
         player.position.tileX = 2;
         player.position.tileY = 2;
         player.position.relative = { 0.2f, 0.5f };
         player.velocity = { 0.0f, 0.0f };
-        player.size     = { 0.46875f * world.tileSideInMeters, 0.78125f * world.tileSideInMeters };
+        player.size     = { 0.46875f * world->tileSideInMeters, 0.78125f * world->tileSideInMeters };
 
         Camera camera;
         camera.position = player.position;
         camera.position.relative = { 0.0f, 0.0f };
-        camera.size = { SCREEN_WIDTH / world.tileSideInPixels + 1, SCREEN_HEIGHT / world.tileSideInPixels + 1 };
+        camera.size = { SCREEN_WIDTH / world->tileSideInPixels + 1, SCREEN_HEIGHT / world->tileSideInPixels + 1 };
         
         GameState gameState;
         gameState.player = player;
         gameState.camera = camera;
-        gameState.world = &world;
+        gameState.world = world;
+
+        return gameState;
+}
+
+// Jump between the starting map and a copy of it FAR_TILE_OFFSET tiles
+// up and to the right, building the copy on the first jump
+internal void
+teleportFar( GameState* gameState )
+{
+        World* world = gameState->world;
+
+        int64 offset = FAR_TILE_OFFSET;
+        if ( gameState->player.position.tileX >= FAR_TILE_OFFSET / 2 )
+        {
+                offset = -FAR_TILE_OFFSET;
+        }
+        else
+        {
+                WorldPosition farCorner = {};
+                farCorner.tileX = FAR_TILE_OFFSET;
+                farCorner.tileY = FAR_TILE_OFFSET;
+                if ( getTileValue( world, farCorner ) == 2 )
+                {
+                        buildStartingMap( world, FAR_TILE_OFFSET, FAR_TILE_OFFSET );
+                }
+        }
+
+        gameState->player.position.tileX += offset;
+        gameState->player.position.tileY += offset;
+        gameState->camera.position.tileX += offset;
+        gameState->camera.position.tileY += offset;
+}
+
+#include "snapshot.cpp"
+#include "rewind.cpp"
+#include "net.cpp"
+#include "audio.cpp"
+#include "raycast.cpp"
+#include "particles.cpp"
+
+#define FAR_TEST_COPIES 4
+#define FAR_TEST_RAYS 16
+
+// a, moved back by offset tiles, is exactly b
+inline bool32
+isSameFarPosition( WorldPosition a, int64 offsetX, int64 offsetY, WorldPosition b )
+{
+        bool32 result = (a.tileX - offsetX == b.tileX && a.tileY - offsetY == b.tileY &&
+                         a.relative.x == b.relative.x && a.relative.y == b.relative.y);
+        return result;
+}
+
+// Play the same input in the starting map and in copies of it up to
+// 10^15 tiles from the origin, and check that everything measured from
+// the map comes out bit for bit the same in every copy: the player and
+// camera, where they are drawn, raycasts from the player, particles and
+// the player after a snapshot and a network round trip
+internal bool32
+runFarWorldTest()
+{
+        int64 offsets[FAR_TEST_COPIES][2] = {
+                { 0, 0 },
+                { FAR_TILE_OFFSET, FAR_TILE_OFFSET },
+                { -FAR_TILE_OFFSET, 3 * FAR_TILE_OFFSET },
+                { 1000000 * FAR_TILE_OFFSET, -1000000 * FAR_TILE_OFFSET },
+        };
+
+        TileMap tileMap;
+        World world;
+        GameState start = initializeGameState( &world, &tileMap );
+
+        GameState gameStates[FAR_TEST_COPIES];
+        ParticleSystem particles[FAR_TEST_COPIES];
+        for ( uint32 copy = 0; copy < FAR_TEST_COPIES; ++copy )
+        {
+                int64 offsetX = offsets[copy][0];
+                int64 offsetY = offsets[copy][1];
+                if ( copy > 0 )
+                {
+                        buildStartingMap( &world, offsetX, offsetY );
+                }
+
+                gameStates[copy] = start;
+                gameStates[copy].player.position.tileX += offsetX;
+                gameStates[copy].player.position.tileY += offsetY;
+                gameStates[copy].camera.position.tileX += offsetX;
+                gameStates[copy].camera.position.tileY += offsetY;
+                initializeParticleSystem( &particles[copy], 1024 );
+        }
+
+        uint32 mismatches = 0;
+        const uint32 TICKS = 1200;
+        for ( uint32 tick = 0; tick < TICKS; ++tick )
+        {
+                // Walk in a square with diagonal corners, bumping into walls
+                uint32 leg = (tick / 45) % 8;
+                V2 directions[8] = { { 1, 0 }, { 1, 1 }, { 0, 1 }, { -1, 1 },
+                                     { -1, 0 }, { -1, -1 }, { 0, -1 }, { 1, -1 } };
+                GameInput input = {};
+                input.move = directions[leg];
+
+                for ( uint32 copy = 0; copy < FAR_TEST_COPIES; ++copy )
+                {
+                        GameState* gameState = &gameStates[copy];
+                        *gameState = updateGame( *gameState, input, 1.0f / 60.0f );
+                        if ( tick % 10 == 0 )
+                        {
+                                emitParticleBurst( &particles[copy], gameState->player.position, 16, 3.0f, 1.0f );
+                        }
+                        updateParticles( &particles[copy], &world, 1.0f / 60.0f );
+                }
+
+                GameState* reference = &gameStates[0];
+                V2 referenceOnScreen = getScreenCoordinates( &world, reference->player.position,
+                                                             reference->camera.position );
+                for ( uint32 copy = 1; copy < FAR_TEST_COPIES; ++copy )
+                {
+                        GameState* gameState = &gameStates[copy];
+                        int64 offsetX = offsets[copy][0];
+                        int64 offsetY = offsets[copy][1];
+
+                        V2 onScreen = getScreenCoordinates( &world, gameState->player.position,
+                                                            gameState->camera.position );
+                        if ( !isSameFarPosition( gameState->player.position, offsetX, offsetY,
+                                                 reference->player.position ) ||
+                             !isSameFarPosition( gameState->camera.position, offsetX, offsetY,
+                                                 reference->camera.position ) ||
+                             onScreen.x != referenceOnScreen.x || onScreen.y != referenceOnScreen.y )
+                        {
+                                ++mismatches;
+                        }
+
+                        for ( uint32 rayIndex = 0; rayIndex < FAR_TEST_RAYS; ++rayIndex )
+                        {
+                                real32 angle = (tick + rayIndex) * (2.0f * 3.14159265f / FAR_TEST_RAYS);
+                                Ray ray = { reference->player.position, { cosf( angle ), sinf( angle ) }, 40.0f };
+                                RayHit referenceHit = castRay( &world, ray );
+                                ray.origin = gameState->player.position;
+                                RayHit hit = castRay( &world, ray );
+                                if ( hit.hit != referenceHit.hit ||
+                                     (hit.hit && (hit.tileX - offsetX != referenceHit.tileX ||
+                                                  hit.tileY - offsetY != referenceHit.tileY ||
+                                                  hit.distance != referenceHit.distance ||
+                                                  !isSameFarPosition( hit.point, offsetX, offsetY, referenceHit.point ))) )
+                                {
+                                        ++mismatches;
+                                }
+                        }
+
+                        ParticleSystem* system = &particles[copy];
+                        ParticleSystem* referenceSystem = &particles[0];
+                        if ( system->count != referenceSystem->count ||
+                             system->originTileX - offsetX != referenceSystem->originTileX ||
+                             system->originTileY - offsetY != referenceSystem->originTileY ||
+                             memcmp( system->tileX, referenceSystem->tileX, system->count * sizeof(int32) ) ||
+                             memcmp( system->tileY, referenceSystem->tileY, system->count * sizeof(int32) ) ||
+                             memcmp( system->relativeX, referenceSystem->relativeX, system->count * sizeof(real32) ) ||
+                             memcmp( system->relativeY, referenceSystem->relativeY, system->count * sizeof(real32) ) )
+                        {
+                                ++mismatches;
+                        }
+                }
+        }
+
+        // Far positions survive saving and replication
+        uint32 chunkBytes = getTileChunkTileCount( &tileMap ) * sizeof(uint32);
+        uint8* scratch = (uint8*)malloc( lzCompressBound( chunkBytes ) );
+        SnapshotBuffer buffer = {};
+        for ( uint32 copy = 1; copy < FAR_TEST_COPIES; ++copy )
+        {
+                GameState saved = gameStates[copy];
+                encodeSnapshot( &buffer, &saved, copy, 0, 0, true, scratch, 0 );
+                GameState loaded = start;
+                if ( !decodeSnapshot( buffer.data, buffer.size, &loaded, 0, 0, 0 ) ||
+                     !isSameFarPosition( loaded.player.position, 0, 0, saved.player.position ) ||
+                     !isSameFarPosition( loaded.camera.position, 0, 0, saved.camera.position ) )
+                {
+                        ++mismatches;
+                }
+
+                Player replicated = dequantizePlayer( quantizePlayer( saved.player ), saved.player );
+                if ( replicated.position.tileX != saved.player.position.tileX ||
+                     replicated.position.tileY != saved.player.position.tileY )
+                {
+                        ++mismatches;
+                }
+        }
+        free( buffer.data );
+        free( scratch );
+
+        printf( "Player tile (%lld, %lld) after %u ticks in %u copies of the map, %u chunks, %u mismatches: %s\n",
+                (long long)gameStates[0].player.position.tileX, (long long)gameStates[0].player.position.tileY,
+                TICKS, FAR_TEST_COPIES, getTileChunkCount( &tileMap ), mismatches,
+                mismatches == 0 ? "PASS" : "FAIL" );
+
+        for ( uint32 copy = 0; copy < FAR_TEST_COPIES; ++copy )
+        {
+                freeParticleSystem( &particles[copy] );
+        }
+        freeTileMap( &tileMap );
+        return mismatches == 0;
+}
+
+// bench.cpp includes this file for everything but main
+#ifndef AUGEN_BENCHMARK
+int32 main( int32 argc, char** argv )
+{
+        // --server runs headless, --client renders a remote server's game,
+        // --loopback runs both in this process
+        bool32 runClient = false;
+        bool32 runLoopbackServer = false;
+        uint16 port = NET_DEFAULT_PORT;
+        if ( argc > 2 )
+        {
+                port = (uint16)atoi( argv[2] );
+        }
+
+        if ( argc > 1 && strcmp( argv[1], "--snapshot-bench" ) == 0 )
+        {
+                benchmarkSnapshots( 4096, 4096 );
+                return 0;
+        }
+        else if ( argc > 1 && strcmp( argv[1], "--audio-bench" ) == 0 )
+        {
+                benchmarkAudio( argc > 2 ? (uint32)atoi( argv[2] ) : 256 );
+                return 0;
+        }
+        else if ( argc > 1 && strcmp( argv[1], "--far-test" ) == 0 )
+        {
+                bool32 passed = runFarWorldTest();
+                return passed ? 0 : 1;
+        }
+        else if ( argc > 1 && strcmp( argv[1], "--net-test" ) == 0 )
+        {
+                bool32 passed = runNetTest( port );
+                return passed ? 0 : 1;
+        }
+        else if ( argc > 1 && strcmp( argv[1], "--server" ) == 0 )
+        {
+                NetServer* server = (NetServer*)calloc( 1, sizeof(NetServer) );
+                if ( !initializeNetServer( server, port ) )
+                {
+                        return 1;
+                }
+                runNetServer( server );
+                return 0;
+        }
+        else if ( argc > 1 && strcmp( argv[1], "--client" ) == 0 )
+        {
+                runClient = true;
+        }
+        else if ( argc > 1 && strcmp( argv[1], "--loopback" ) == 0 )
+        {
+                runClient = true;
+                runLoopbackServer = true;
+        }
+
+        // Initialize SDL and create window
+        SDL_Window* window = initializeSDL();
+        if ( window == NULL )
+        {
+                printf( "Window could not be created. SDL_Error: %s\n",
+                        SDL_GetError() );
+                return 0;
+        }
+
+        // Create Renderer
+        SDL_Renderer* renderer = createRenderer( window );
+        if( renderer == NULL )
+        {
+                printf( "Renderer could not be created. SDL Error: %s\n",
+                        SDL_GetError() );
+                return 0;
+        }
+
+        TileMap tileMap;
+        World world;
+        GameState gameState = initializeGameState( &world, &tileMap );
 
         // While running
         bool quit = false;
@@ -442,21 +996,169 @@ int32 main( int32 argc, char** argv )
         uint32 currentTime = SDL_GetTicks();
         real32 dt;
         int32 consoleCounter = 0;
+
+        SnapshotWriter snapshotWriter = {};
+
+        // Frames are recorded once per update, at 60 updates a second
+        RewindBuffer rewind = {};
+        initializeRewindBuffer( &rewind, &gameState, REWIND_SECONDS * 60, REWIND_MEMORY_BUDGET );
+
+        // The game runs without sound if there is no audio device
+        AudioMixer* mixer = (AudioMixer*)calloc( 1, sizeof(AudioMixer) );
+        if ( !openAudioMixer( mixer ) )
+        {
+                free( mixer );
+                mixer = 0;
+        }
+        Sound saveSound = makeToneSound( 880.0f, 0.15f, AUDIO_SAMPLE_RATE, 30.0f );
+        Sound loadSound = makeToneSound( 440.0f, 0.15f, AUDIO_SAMPLE_RATE, 30.0f );
+
+        // A whole number of cycles, so that it loops without a click
+        Sound rewindSound = makeToneSound( 110.0f, 1.0f, AUDIO_SAMPLE_RATE, 0.0f );
+        uint32 rewindVoice = 0;
+        real32 rewindPitch = 0.0f;
+
+        ParticleSystem dust;
+        initializeParticleSystem( &dust, 4096 );
+        WorldPosition lastPlayerPosition = gameState.player.position;
+
+        NetServer* server = 0;
+        SDL_Thread* serverThread = 0;
+        if ( runLoopbackServer )
+        {
+                server = (NetServer*)calloc( 1, sizeof(NetServer) );
+                if ( !initializeNetServer( server, port ) )
+                {
+                        return 1;
+                }
+                serverThread = SDL_CreateThread( runNetServer, "NetServer", server );
+        }
+
+        NetClient* client = 0;
+        SnapshotBuffer clientBuffer = {};
+        if ( runClient )
+        {
+                client = (NetClient*)calloc( 1, sizeof(NetClient) );
+                if ( !initializeNetClient( client, gameState, port ) )
+                {
+                        return 1;
+                }
+        }
         
         while ( !quit )
         {
                 // Handle events on the queue
-                quit = parseEvents();
+                PlatformCommands commands = {};
+                quit = parseEvents( &commands );
+
+                // The server owns the state of a networked game
+                if ( client )
+                {
+                        commands.saveSnapshot = false;
+                        commands.loadSnapshot = false;
+                        commands.rewind = false;
+                        commands.rewindForward = false;
+                        commands.teleport = false;
+                }
+
+                if ( commands.teleport )
+                {
+                        teleportFar( &gameState );
+                }
+
+                if ( commands.saveSnapshot )
+                {
+                        if ( !saveSnapshot( &snapshotWriter, gameState,
+                                            SNAPSHOT_BASE_PATH, SNAPSHOT_DELTA_PATH, true ) )
+                        {
+                                printf( "Snapshot is still being written.\n" );
+                        }
+                        else if ( mixer )
+                        {
+                                playSound( mixer, &saveSound, 0.5f, 0.0f, 1.0f, false );
+                        }
+                }
+                if ( commands.loadSnapshot )
+                {
+                        // Saves after a load start over from a full snapshot
+                        resetSnapshotWriter( &snapshotWriter );
+                        if ( loadSnapshot( &gameState, SNAPSHOT_BASE_PATH, SNAPSHOT_DELTA_PATH ) )
+                        {
+                                resetRewindBuffer( &rewind, &gameState );
+                        }
+                        if ( mixer )
+                        {
+                                // Nothing that was playing belongs to the loaded state
+                                stopAllSounds( mixer );
+                                rewindVoice = 0;
+                                playSound( mixer, &loadSound, 0.5f, 0.0f, 1.0f, false );
+                        }
+                }
                 
                 lastTime = currentTime;
                 currentTime = SDL_GetTicks();
                 dt = ((real32)currentTime - (real32)lastTime) / 1000;
 
-                // Update game state
-                gameState = updateGame( gameState, dt );
+                collectSnapshotWriter( &snapshotWriter );
+
+                if ( client )
+                {
+                        GameInput input = readGameInput();
+                        updateNetClient( client, &clientBuffer, input, dt );
+                        gameState = client->predicted;
+                }
+                else if ( commands.rewind )
+                {
+                        stepRewindBack( &rewind, &gameState );
+                }
+                else if ( commands.rewindForward )
+                {
+                        stepRewindForward( &rewind, &gameState );
+                }
+                else
+                {
+                        // Update game state
+                        GameInput input = readGameInput();
+                        gameState = updateGame( gameState, input, dt );
+                        recordRewindFrame( &rewind, &gameState );
+                }
+
+                // Hum while stepping through the rewind history, lower
+                // when going back than when going forward
+                if ( mixer )
+                {
+                        bool rewinding = commands.rewind || commands.rewindForward;
+                        real32 pitch = commands.rewind ? 0.75f : 1.0f;
+                        if ( rewinding && !rewindVoice )
+                        {
+                                rewindVoice = playSound( mixer, &rewindSound, 0.2f, 0.0f, pitch, true );
+                                rewindPitch = pitch;
+                        }
+                        else if ( rewinding && pitch != rewindPitch )
+                        {
+                                changeSound( mixer, rewindVoice, 0.2f, 0.0f, pitch );
+                                rewindPitch = pitch;
+                        }
+                        else if ( !rewinding && rewindVoice )
+                        {
+                                stopSound( mixer, rewindVoice );
+                                rewindVoice = 0;
+                        }
+                }
+                
+                // Kick up dust while the player moves
+                if ( gameState.player.position.tileX != lastPlayerPosition.tileX ||
+                     gameState.player.position.tileY != lastPlayerPosition.tileY ||
+                     gameState.player.position.relative.x != lastPlayerPosition.relative.x ||
+                     gameState.player.position.relative.y != lastPlayerPosition.relative.y )
+                {
+                        emitParticleBurst( &dust, gameState.player.position, 2, 1.5f, 0.6f );
+                }
+                lastPlayerPosition = gameState.player.position;
+                updateParticles( &dust, &world, dt );
                 
                 // Draw to the screen
-                draw( window, renderer, gameState );
+                draw( window, renderer, gameState, &dust );
 
                 // Limit to 60 fps
                 SDL_Delay( 1000 / 60 );
@@ -465,23 +1167,51 @@ int32 main( int32 argc, char** argv )
                 if (consoleCounter >= 60)
                 {
                         consoleCounter = 0;
+                        if ( client )
+                        {
+                                reportNetStats( "client", &client->stats );
+                        }
                         printf("Player (%f, %f)\n",
                                gameState.player.position.relative.x,
                                gameState.player.position.relative.y);
-                        printf("PlayerTile (%d, %d)\n",
-                               gameState.player.position.tileX,
-                               gameState.player.position.tileY);
+                        printf("PlayerTile (%lld, %lld)\n",
+                               (long long)gameState.player.position.tileX,
+                               (long long)gameState.player.position.tileY);
                         printf("Camera (%f, %f)\n",
                                gameState.camera.position.relative.x,
                                gameState.camera.position.relative.y);
-                        printf("CameraTile (%d, %d)\n",
-                               gameState.camera.position.tileX,
-                               gameState.camera.position.tileY);
+                        printf("CameraTile (%lld, %lld)\n",
+                               (long long)gameState.camera.position.tileX,
+                               (long long)gameState.camera.position.tileY);
                 }
         }
 
+        finishSnapshotWriter( &snapshotWriter );
+        freeRewindBuffer( &rewind );
+
+        if ( mixer )
+        {
+                closeAudioMixer( mixer );
+                free( mixer );
+        }
+        freeSound( &saveSound );
+        freeSound( &loadSound );
+        freeSound( &rewindSound );
+        freeParticleSystem( &dust );
+
+        if ( client )
+        {
+                closeNetClient( client );
+        }
+        if ( serverThread )
+        {
+                SDL_AtomicSet( &server->quit, 1 );
+                SDL_WaitThread( serverThread, NULL );
+        }
+
         // Free resources and shutdown SDL
         shutdownSDL( window, renderer );
     
         return 0;
 }
+#endif
@@ -5,6 +5,8 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <string>
 
 typedef int8_t  int8;
@@ -33,23 +35,72 @@ struct V2
 
 struct TileChunkPosition
 {
-        uint32 tileMapX;
-        uint32 tileMapY;
+        int64 tileChunkX;
+        int64 tileChunkY;
 
-        int32 tileX;
-        int32 tileY;
+        uint32 tileX;
+        uint32 tileY;
 };
 
+// Tile coordinates are 64 bit so that the world can be far larger than
+// a float can address; relative stays within half a tile of the tile's
+// center. Anything that needs meters or pixels works on the difference
+// between two positions (see subtractPositions), so float math only
+// ever sees small numbers however far from the origin both are.
 struct WorldPosition
 {
-        int32 tileX;
-        int32 tileY;
+        int64 tileX;
+        int64 tileY;
         V2 relative;
 };
 
-struct TileMap
+// Chunk tiles are reference counted so that saves and the rewind
+// history can share them with the live world. Writes go through
+// setTileValue, which copies the tiles first if they are shared.
+struct TileChunk
 {
+        int64 chunkX;
+        int64 chunkY;
+
         uint32* tiles;
+        int32* refCount;
+};
+
+struct TileChunkList
+{
+        uint32* chunkIndices;
+        uint32 count;
+        uint32 capacity;
+};
+
+// The tile map is split into square chunks of (1 << chunkShift) tiles
+// per side so that they can be saved and restored independently.
+//
+// The map is sparse: a chunk only exists once one of its tiles is set,
+// and tiles that were never set read as 2, like out of bounds tiles
+// used to. Chunks are kept in the order they were created and never
+// removed, so an index into tileChunks stays valid for as long as the
+// map does. chunkHash maps chunk coordinates to those indices.
+struct TileMap
+{
+        uint32 chunkShift;
+        uint32 chunkMask;
+        uint32 chunkDim;
+
+        uint32 tileChunkCount;
+        uint32 tileChunkCapacity;
+        TileChunk* tileChunks;
+
+        // Open addressing, linear probing. Slots hold a chunk index plus
+        // one, 0 is an empty slot. The capacity is a power of two.
+        uint32 chunkHashCapacity;
+        uint32* chunkHash;
+
+        // If set, every chunk that is created or copied before a write
+        // is appended here. A chunk that something else holds on to is
+        // copied before its first write, so the rewind history, which
+        // holds on to every chunk, learns of each change exactly once.
+        TileChunkList* dirtyChunks;
 };
 
 struct World
@@ -58,9 +109,6 @@ struct World
         real32 tileSideInPixels;
         real32 metersToPixels;
 
-        int32 tileCountX;
-        int32 tileCountY;
-        
         TileMap* tileMap;
 };
 
@@ -77,6 +125,14 @@ struct Camera
         V2 size;
 };
 
+// Player intent for one update, sampled from the keyboard or received
+// from a client
+struct GameInput
+{
+        // Direction of movement, each axis in [-1, 1]
+        V2 move;
+};
+
 struct GameState
 {
         Player player;
@@ -0,0 +1,745 @@
+// Networking
+//
+// A client/server split over UDP on localhost. The server owns the
+// authoritative GameState and runs updateGame on the input commands the
+// client sends it. The client runs the same code on its own commands to
+// predict the local player, and corrects itself whenever a snapshot
+// arrives by replaying the commands the server had not yet processed.
+//
+// Input packets (client to server):
+//   type, acked snapshot, client time, command count, first sequence,
+//   then per command: move x, move y, dt
+// Snapshot packets (server to client):
+//   type, sequence, base sequence (0 if none), last processed input,
+//   echoed client time, entity count, then per entity a change mask
+//   and a zigzag varint delta against the base for each changed field
+//
+// Every command the server hasn't acknowledged is repeated in each input
+// packet and snapshots are encoded against the last one the client
+// acknowledged, so either direction tolerates packet loss without
+// retransmission.
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+//
+// Sockets
+//
+
+// Bind a non-blocking UDP socket to localhost. Port 0 picks any port.
+internal bool32
+openNetSocket( NetSocket* netSocket, uint16 port )
+{
+        netSocket->handle = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+        if ( netSocket->handle < 0 )
+        {
+                printf( "Unable to create socket.\n" );
+                return false;
+        }
+
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+        address.sin_port = htons( port );
+        if ( bind( netSocket->handle, (sockaddr*)&address, sizeof(address) ) < 0 )
+        {
+                printf( "Unable to bind socket to port %u.\n", port );
+                close( netSocket->handle );
+                netSocket->handle = -1;
+                return false;
+        }
+
+        int32 flags = fcntl( netSocket->handle, F_GETFL, 0 );
+        fcntl( netSocket->handle, F_SETFL, flags | O_NONBLOCK );
+
+        if ( netSocket->dropSeed == 0 )
+        {
+                netSocket->dropSeed = 0x9E3779B9;
+        }
+        return true;
+}
+
+internal void
+closeNetSocket( NetSocket* netSocket )
+{
+        if ( netSocket->handle >= 0 )
+        {
+                close( netSocket->handle );
+                netSocket->handle = -1;
+        }
+}
+
+internal void
+sendNetPacket( NetSocket* netSocket, NetAddress to, uint8* data, uint32 size )
+{
+        if ( netSocket->dropPercent )
+        {
+                // xorshift32
+                uint32 x = netSocket->dropSeed;
+                x ^= x << 13;
+                x ^= x >> 17;
+                x ^= x << 5;
+                netSocket->dropSeed = x;
+                if ( x % 100 < netSocket->dropPercent )
+                {
+                        return;
+                }
+        }
+
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl( to.host );
+        address.sin_port = htons( to.port );
+        sendto( netSocket->handle, data, size, 0, (sockaddr*)&address, sizeof(address) );
+}
+
+// Returns the packet size, or -1 if nothing is waiting
+internal int32
+receiveNetPacket( NetSocket* netSocket, NetAddress* from, uint8* data, uint32 capacity )
+{
+        sockaddr_in address;
+        socklen_t addressSize = sizeof(address);
+        int32 size = (int32)recvfrom( netSocket->handle, data, capacity, 0,
+                                      (sockaddr*)&address, &addressSize );
+        if ( size >= 0 )
+        {
+                from->host = ntohl( address.sin_addr.s_addr );
+                from->port = ntohs( address.sin_port );
+        }
+        return size;
+}
+
+inline bool32
+operator==( NetAddress a, NetAddress b )
+{
+        bool32 result = (a.host == b.host && a.port == b.port);
+        return result;
+}
+
+inline uint32
+getNetTime()
+{
+        // Microseconds, wrapping about every 71 minutes
+        uint64 counter = SDL_GetPerformanceCounter();
+        uint64 frequency = SDL_GetPerformanceFrequency();
+        uint32 result = (uint32)((counter / frequency) * 1000000 +
+                                 ((counter % frequency) * 1000000) / frequency);
+        return result;
+}
+
+//
+// Encoding
+//
+
+internal void
+writeVarUint32( SnapshotBuffer* buffer, uint32 value )
+{
+        while ( value >= 0x80 )
+        {
+                writeUint8( buffer, (uint8)(value | 0x80) );
+                value >>= 7;
+        }
+        writeUint8( buffer, (uint8)value );
+}
+
+internal uint32
+readVarUint32( SnapshotReader* reader )
+{
+        uint32 result = 0;
+        for ( uint32 shift = 0; shift < 35; shift += 7 )
+        {
+                uint8 byte = readUint8( reader );
+                result |= (uint32)(byte & 0x7F) << shift;
+                if ( !(byte & 0x80) )
+                {
+                        return result;
+                }
+        }
+        reader->valid = false;
+        return 0;
+}
+
+// Map small negative numbers to small unsigned ones
+inline uint32
+zigZagEncode( int32 value )
+{
+        uint32 result = ((uint32)value << 1) ^ (uint32)(value >> 31);
+        return result;
+}
+
+inline int32
+zigZagDecode( uint32 value )
+{
+        int32 result = (int32)(value >> 1) ^ -(int32)(value & 1);
+        return result;
+}
+
+inline int32
+quantizeReal32( real32 value, real32 steps )
+{
+        int32 result = floorReal32ToInt32( value * steps + 0.5f );
+        return result;
+}
+
+internal NetEntityState
+quantizePlayer( Player player )
+{
+        NetEntityState result;
+
+        result.fields[NetEntityField_TileX] = (int32)(uint32)player.position.tileX;
+        result.fields[NetEntityField_TileY] = (int32)(uint32)player.position.tileY;
+        result.fields[NetEntityField_TileXHigh] = (int32)(player.position.tileX >> 32);
+        result.fields[NetEntityField_TileYHigh] = (int32)(player.position.tileY >> 32);
+        result.fields[NetEntityField_RelativeX] = quantizeReal32( player.position.relative.x, NET_POSITION_STEPS_PER_METER );
+        result.fields[NetEntityField_RelativeY] = quantizeReal32( player.position.relative.y, NET_POSITION_STEPS_PER_METER );
+        result.fields[NetEntityField_VelocityX] = quantizeReal32( player.velocity.x, NET_VELOCITY_STEPS_PER_METER );
+        result.fields[NetEntityField_VelocityY] = quantizeReal32( player.velocity.y, NET_VELOCITY_STEPS_PER_METER );
+
+        return result;
+}
+
+// The size isn't replicated, it is taken from player
+internal Player
+dequantizePlayer( NetEntityState state, Player player )
+{
+        player.position.tileX = (int64)(((uint64)(uint32)state.fields[NetEntityField_TileXHigh] << 32) |
+                                        (uint32)state.fields[NetEntityField_TileX]);
+        player.position.tileY = (int64)(((uint64)(uint32)state.fields[NetEntityField_TileYHigh] << 32) |
+                                        (uint32)state.fields[NetEntityField_TileY]);
+        player.position.relative.x = state.fields[NetEntityField_RelativeX] / NET_POSITION_STEPS_PER_METER;
+        player.position.relative.y = state.fields[NetEntityField_RelativeY] / NET_POSITION_STEPS_PER_METER;
+        player.velocity.x = state.fields[NetEntityField_VelocityX] / NET_VELOCITY_STEPS_PER_METER;
+        player.velocity.y = state.fields[NetEntityField_VelocityY] / NET_VELOCITY_STEPS_PER_METER;
+
+        return player;
+}
+
+internal InputCommand
+quantizeInput( GameInput input, real32 dt )
+{
+        InputCommand result = {};
+
+        int32 moveX = quantizeReal32( input.move.x, NET_MOVE_STEPS );
+        int32 moveY = quantizeReal32( input.move.y, NET_MOVE_STEPS );
+        int32 dtSteps = quantizeReal32( dt, NET_DT_STEPS_PER_SECOND );
+        result.moveX = (int8)(moveX < -127 ? -127 : moveX > 127 ? 127 : moveX);
+        result.moveY = (int8)(moveY < -127 ? -127 : moveY > 127 ? 127 : moveY);
+        result.dt = (uint16)(dtSteps < 0 ? 0 : dtSteps > 65535 ? 65535 : dtSteps);
+
+        return result;
+}
+
+// Both ends simulate with this so that they stay in lockstep. The
+// player is kept on the quantization grid, so what the server sends is
+// exactly what it has.
+internal void
+applyInputCommand( GameState* gameState, InputCommand command )
+{
+        GameInput input;
+        input.move.x = command.moveX / NET_MOVE_STEPS;
+        input.move.y = command.moveY / NET_MOVE_STEPS;
+        real32 dt = command.dt / NET_DT_STEPS_PER_SECOND;
+
+        *gameState = updateGame( *gameState, input, dt );
+        gameState->player = dequantizePlayer( quantizePlayer( gameState->player ), gameState->player );
+}
+
+// The player is the only entity so far
+internal void
+buildNetSnapshot( NetSnapshot* snapshot, GameState* gameState, uint32 sequence )
+{
+        snapshot->sequence = sequence;
+        snapshot->entityCount = 1;
+        snapshot->entities[0] = quantizePlayer( gameState->player );
+}
+
+internal void
+writeSnapshotPacket( SnapshotBuffer* buffer,
+                     NetSnapshot* snapshot,
+                     NetSnapshot* base,
+                     uint32 lastProcessedInput,
+                     uint32 echoTime )
+{
+        NetEntityState zero = {};
+
+        buffer->size = 0;
+        writeUint8( buffer, NetPacket_Snapshot );
+        writeUint32( buffer, snapshot->sequence );
+        writeUint32( buffer, base ? base->sequence : 0 );
+        writeUint32( buffer, lastProcessedInput );
+        writeUint32( buffer, echoTime );
+        writeVarUint32( buffer, snapshot->entityCount );
+
+        for ( uint32 entityIndex = 0; entityIndex < snapshot->entityCount; ++entityIndex )
+        {
+                NetEntityState* to = &snapshot->entities[entityIndex];
+                NetEntityState* from = (base && entityIndex < base->entityCount) ?
+                        &base->entities[entityIndex] : &zero;
+
+                uint8 mask = 0;
+                for ( uint32 field = 0; field < NetEntityField_Count; ++field )
+                {
+                        if ( to->fields[field] != from->fields[field] )
+                        {
+                                mask |= (uint8)(1 << field);
+                        }
+                }
+
+                writeUint8( buffer, mask );
+                for ( uint32 field = 0; field < NetEntityField_Count; ++field )
+                {
+                        if ( mask & (1 << field) )
+                        {
+                                int32 delta = (int32)((uint32)to->fields[field] - (uint32)from->fields[field]);
+                                writeVarUint32( buffer, zigZagEncode( delta ) );
+                        }
+                }
+        }
+}
+
+internal void
+addRoundTrip( NetStats* stats, uint32 sentTime )
+{
+        real64 milliseconds = (uint32)(getNetTime() - sentTime) / 1000.0;
+        stats->rttSum += milliseconds;
+        if ( milliseconds > stats->rttMax )
+        {
+                stats->rttMax = milliseconds;
+        }
+        ++stats->rttSamples;
+}
+
+// Print per tick averages since the last report and start over
+internal void
+reportNetStats( const char* name, NetStats* stats )
+{
+        real64 ticks = stats->ticks ? (real64)stats->ticks : 1.0;
+        real64 rttAverage = stats->rttSamples ? stats->rttSum / stats->rttSamples : 0.0;
+
+        printf( "%s: %u ticks, sent %.1f B/tick, received %.1f B/tick, "
+                "%u full / %u delta snapshots",
+                name, stats->ticks, stats->bytesSent / ticks, stats->bytesReceived / ticks,
+                stats->fullSnapshots, stats->deltaSnapshots );
+        if ( stats->rttSamples )
+        {
+                printf( ", rtt %.3f ms avg %.3f ms max", rttAverage, stats->rttMax );
+        }
+        if ( stats->inputsLost )
+        {
+                printf( ", %u inputs lost", stats->inputsLost );
+        }
+        printf( "\n" );
+
+        NetStats zero = {};
+        *stats = zero;
+}
+
+//
+// Server
+//
+
+internal bool32
+initializeNetServer( NetServer* server, uint16 port )
+{
+        server->gameState = initializeGameState( &server->world, &server->tileMap );
+        server->tickMilliseconds = 1000 / 60;
+        if ( !openNetSocket( &server->socket, port ) )
+        {
+                return false;
+        }
+        printf( "Server listening on 127.0.0.1:%u\n", port );
+        return true;
+}
+
+internal void
+readInputPacket( NetServer* server, SnapshotReader* reader )
+{
+        uint32 ack = readUint32( reader );
+        uint32 clientTime = readUint32( reader );
+        uint8 commandCount = readUint8( reader );
+        uint32 firstSequence = readUint32( reader );
+
+        InputCommand commands[NET_INPUTS_PER_PACKET];
+        if ( commandCount > NET_INPUTS_PER_PACKET )
+        {
+                return;
+        }
+        for ( uint32 i = 0; i < commandCount; ++i )
+        {
+                commands[i].sequence = firstSequence + i;
+                commands[i].moveX = (int8)readUint8( reader );
+                commands[i].moveY = (int8)readUint8( reader );
+                uint8 dtLow = readUint8( reader );
+                uint8 dtHigh = readUint8( reader );
+                commands[i].dt = (uint16)(dtLow | (dtHigh << 8));
+        }
+        if ( !reader->valid )
+        {
+                return;
+        }
+
+        if ( ack > server->ackedSnapshot && ack <= server->snapshotSequence )
+        {
+                server->ackedSnapshot = ack;
+        }
+        server->lastClientTime = clientTime;
+
+        // Commands repeat across packets, only run the new ones. A gap
+        // before them means the packets with the commands in between
+        // were all lost, and those commands can no longer be run.
+        for ( uint32 i = 0; i < commandCount; ++i )
+        {
+                if ( commands[i].sequence > server->lastProcessedInput )
+                {
+                        server->stats.inputsLost += commands[i].sequence - server->lastProcessedInput - 1;
+                        applyInputCommand( &server->gameState, commands[i] );
+                        server->lastProcessedInput = commands[i].sequence;
+                }
+        }
+}
+
+// Run the commands that arrived since the last tick and send the client
+// a snapshot of the result
+internal void
+updateNetServer( NetServer* server, SnapshotBuffer* buffer )
+{
+        NetStats* stats = &server->stats;
+        uint8 packet[NET_MAX_PACKET_SIZE];
+        NetAddress from;
+        int32 size;
+
+        while ( (size = receiveNetPacket( &server->socket, &from, packet, sizeof(packet) )) >= 0 )
+        {
+                stats->bytesReceived += size;
+                ++stats->packetsReceived;
+
+                SnapshotReader reader = { packet, packet + size, true };
+                if ( readUint8( &reader ) != NetPacket_Input )
+                {
+                        continue;
+                }
+                if ( !server->hasClient )
+                {
+                        printf( "Client connected from port %u\n", from.port );
+                        server->hasClient = true;
+                        server->client = from;
+                }
+                else if ( !(from == server->client) )
+                {
+                        continue;
+                }
+                readInputPacket( server, &reader );
+        }
+
+        if ( server->hasClient )
+        {
+                uint32 sequence = ++server->snapshotSequence;
+                NetSnapshot* snapshot = &server->sent[sequence % NET_SNAPSHOT_HISTORY];
+                buildNetSnapshot( snapshot, &server->gameState, sequence );
+
+                NetSnapshot* base = 0;
+                uint32 acked = server->ackedSnapshot;
+                if ( acked && sequence - acked < NET_SNAPSHOT_HISTORY &&
+                     server->sent[acked % NET_SNAPSHOT_HISTORY].sequence == acked )
+                {
+                        base = &server->sent[acked % NET_SNAPSHOT_HISTORY];
+                        ++stats->deltaSnapshots;
+                }
+                else
+                {
+                        ++stats->fullSnapshots;
+                }
+
+                writeSnapshotPacket( buffer, snapshot, base,
+                                     server->lastProcessedInput, server->lastClientTime );
+                sendNetPacket( &server->socket, server->client, buffer->data, buffer->size );
+                stats->bytesSent += buffer->size;
+                ++stats->packetsSent;
+        }
+
+        ++stats->ticks;
+}
+
+// Tick the server until its quit flag is set
+internal int
+runNetServer( void* data )
+{
+        NetServer* server = (NetServer*)data;
+        SnapshotBuffer buffer = {};
+        uint32 lastReport = SDL_GetTicks();
+
+        while ( !SDL_AtomicGet( &server->quit ) )
+        {
+                updateNetServer( server, &buffer );
+                if ( SDL_GetTicks() - lastReport >= 1000 )
+                {
+                        lastReport = SDL_GetTicks();
+                        reportNetStats( "server", &server->stats );
+                }
+                SDL_Delay( server->tickMilliseconds );
+        }
+
+        free( buffer.data );
+        closeNetSocket( &server->socket );
+        return 0;
+}
+
+//
+// Client
+//
+
+internal bool32
+initializeNetClient( NetClient* client, GameState gameState, uint16 serverPort )
+{
+        client->server.host = INADDR_LOOPBACK;
+        client->server.port = serverPort;
+        client->predicted = gameState;
+        client->nextInput = 1;
+        bool32 result = openNetSocket( &client->socket, 0 );
+        return result;
+}
+
+// Returns false if the packet is malformed or its base is unknown
+internal bool32
+readSnapshotPacket( NetClient* client, SnapshotReader* reader )
+{
+        uint32 sequence = readUint32( reader );
+        uint32 baseSequence = readUint32( reader );
+        uint32 lastProcessedInput = readUint32( reader );
+        uint32 echoTime = readUint32( reader );
+        uint32 entityCount = readVarUint32( reader );
+        if ( !reader->valid || entityCount > NET_MAX_ENTITIES || sequence == 0 )
+        {
+                return false;
+        }
+
+        // Late packets are superseded by what has already arrived
+        if ( sequence <= client->latestSnapshot )
+        {
+                return true;
+        }
+
+        NetSnapshot* base = 0;
+        if ( baseSequence )
+        {
+                base = &client->received[baseSequence % NET_SNAPSHOT_HISTORY];
+                if ( base->sequence != baseSequence )
+                {
+                        return false;
+                }
+        }
+
+        NetSnapshot snapshot;
+        snapshot.sequence = sequence;
+        snapshot.entityCount = entityCount;
+        for ( uint32 entityIndex = 0; entityIndex < entityCount; ++entityIndex )
+        {
+                NetEntityState* to = &snapshot.entities[entityIndex];
+                *to = (base && entityIndex < base->entityCount) ?
+                        base->entities[entityIndex] : NetEntityState();
+
+                uint8 mask = readUint8( reader );
+                for ( uint32 field = 0; field < NetEntityField_Count; ++field )
+                {
+                        if ( mask & (1 << field) )
+                        {
+                                int32 delta = zigZagDecode( readVarUint32( reader ) );
+                                to->fields[field] = (int32)((uint32)to->fields[field] + (uint32)delta);
+                        }
+                }
+        }
+        if ( !reader->valid )
+        {
+                return false;
+        }
+
+        if ( base )
+        {
+                ++client->stats.deltaSnapshots;
+        }
+        else
+        {
+                ++client->stats.fullSnapshots;
+        }
+        client->received[sequence % NET_SNAPSHOT_HISTORY] = snapshot;
+        client->latestSnapshot = sequence;
+        if ( lastProcessedInput > client->lastProcessedInput )
+        {
+                client->lastProcessedInput = lastProcessedInput;
+        }
+        addRoundTrip( &client->stats, echoTime );
+        return true;
+}
+
+// Send every command the server hasn't acknowledged yet, starting from
+// the one after lastProcessedInput. If more are pending than a packet
+// holds the oldest are left out, and the server counts them as lost.
+internal void
+sendInputPacket( NetClient* client, SnapshotBuffer* buffer )
+{
+        uint32 newest = client->nextInput - 1;
+        uint32 pending = newest - client->lastProcessedInput;
+        uint32 count = pending < NET_INPUTS_PER_PACKET ? pending : NET_INPUTS_PER_PACKET;
+        if ( count == 0 )
+        {
+                count = 1;
+        }
+        uint32 firstSequence = newest - count + 1;
+
+        buffer->size = 0;
+        writeUint8( buffer, NetPacket_Input );
+        writeUint32( buffer, client->latestSnapshot );
+        writeUint32( buffer, getNetTime() );
+        writeUint8( buffer, (uint8)count );
+        writeUint32( buffer, firstSequence );
+        for ( uint32 sequence = firstSequence; sequence <= newest; ++sequence )
+        {
+                InputCommand* command = &client->inputs[sequence % NET_INPUT_HISTORY];
+                writeUint8( buffer, (uint8)command->moveX );
+                writeUint8( buffer, (uint8)command->moveY );
+                writeUint8( buffer, (uint8)(command->dt & 0xFF) );
+                writeUint8( buffer, (uint8)(command->dt >> 8) );
+        }
+
+        sendNetPacket( &client->socket, client->server, buffer->data, buffer->size );
+        client->stats.bytesSent += buffer->size;
+        ++client->stats.packetsSent;
+}
+
+// Apply the newest snapshot, predict this tick's input on top of it,
+// and send the input to the server
+internal void
+updateNetClient( NetClient* client, SnapshotBuffer* buffer, GameInput input, real32 dt )
+{
+        NetStats* stats = &client->stats;
+        uint8 packet[NET_MAX_PACKET_SIZE];
+        NetAddress from;
+        int32 size;
+        uint32 latestSnapshot = client->latestSnapshot;
+
+        while ( (size = receiveNetPacket( &client->socket, &from, packet, sizeof(packet) )) >= 0 )
+        {
+                stats->bytesReceived += size;
+                ++stats->packetsReceived;
+
+                SnapshotReader reader = { packet, packet + size, true };
+                if ( from == client->server && readUint8( &reader ) == NetPacket_Snapshot )
+                {
+                        readSnapshotPacket( client, &reader );
+                }
+        }
+
+        if ( client->latestSnapshot != latestSnapshot )
+        {
+                // Start from the server's state and replay what it hasn't seen
+                NetSnapshot* snapshot = &client->received[client->latestSnapshot % NET_SNAPSHOT_HISTORY];
+                client->predicted.player = dequantizePlayer( snapshot->entities[0], client->predicted.player );
+
+                uint32 firstPending = client->lastProcessedInput + 1;
+                if ( client->nextInput - firstPending > NET_INPUT_HISTORY )
+                {
+                        firstPending = client->nextInput - NET_INPUT_HISTORY;
+                }
+                for ( uint32 sequence = firstPending; sequence < client->nextInput; ++sequence )
+                {
+                        applyInputCommand( &client->predicted, client->inputs[sequence % NET_INPUT_HISTORY] );
+                }
+        }
+
+        InputCommand command = quantizeInput( input, dt );
+        command.sequence = client->nextInput++;
+        client->inputs[command.sequence % NET_INPUT_HISTORY] = command;
+        applyInputCommand( &client->predicted, command );
+
+        sendInputPacket( client, buffer );
+        ++stats->ticks;
+}
+
+internal void
+closeNetClient( NetClient* client )
+{
+        closeNetSocket( &client->socket );
+}
+
+//
+// Self test
+//
+
+// Run a server thread and a scripted client against each other over
+// localhost with packet loss in both directions, then check that the
+// client's prediction agrees with the server
+internal bool32
+runNetTest( uint16 port )
+{
+        NetServer* server = (NetServer*)calloc( 1, sizeof(NetServer) );
+        server->socket.dropPercent = 10;
+        if ( !initializeNetServer( server, port ) )
+        {
+                free( server );
+                return false;
+        }
+        server->tickMilliseconds = 1;
+        SDL_Thread* thread = SDL_CreateThread( runNetServer, "NetServer", server );
+
+        TileMap tileMap;
+        World world;
+        GameState gameState = initializeGameState( &world, &tileMap );
+
+        NetClient* client = (NetClient*)calloc( 1, sizeof(NetClient) );
+        client->socket.dropPercent = 10;
+        initializeNetClient( client, gameState, port );
+
+        SnapshotBuffer buffer = {};
+        const uint32 MOVING_TICKS = 600;
+        const uint32 IDLE_TICKS = 120;
+        for ( uint32 tick = 0; tick < MOVING_TICKS + IDLE_TICKS; ++tick )
+        {
+                // Walk in a square with diagonal corners, then stand still
+                GameInput input = {};
+                if ( tick < MOVING_TICKS )
+                {
+                        uint32 leg = (tick / 30) % 8;
+                        V2 directions[8] = { { 1, 0 }, { 1, 1 }, { 0, 1 }, { -1, 1 },
+                                             { -1, 0 }, { -1, -1 }, { 0, -1 }, { 1, -1 } };
+                        input.move = directions[leg];
+                }
+                updateNetClient( client, &buffer, input, 1.0f / 60.0f );
+                if ( client->stats.ticks == 120 )
+                {
+                        reportNetStats( "client", &client->stats );
+                }
+                SDL_Delay( 1 );
+        }
+
+        SDL_AtomicSet( &server->quit, 1 );
+        SDL_WaitThread( thread, NULL );
+        if ( client->stats.ticks )
+        {
+                reportNetStats( "client", &client->stats );
+        }
+        reportNetStats( "server", &server->stats );
+
+        NetEntityState serverPlayer = quantizePlayer( server->gameState.player );
+        NetEntityState clientPlayer = quantizePlayer( client->predicted.player );
+        bool32 result = (memcmp( &serverPlayer, &clientPlayer, sizeof(serverPlayer) ) == 0 &&
+                         server->lastProcessedInput > MOVING_TICKS / 2);
+
+        printf( "Server player tile (%lld, %lld) processed %u inputs, client player tile (%lld, %lld): %s\n",
+                (long long)server->gameState.player.position.tileX,
+                (long long)server->gameState.player.position.tileY,
+                server->lastProcessedInput,
+                (long long)client->predicted.player.position.tileX,
+                (long long)client->predicted.player.position.tileY,
+                result ? "PASS" : "FAIL" );
+
+        closeNetClient( client );
+        free( buffer.data );
+        free( client );
+        freeTileMap( &server->tileMap );
+        free( server );
+        freeTileMap( &tileMap );
+        return result;
+}
@@ -0,0 +1,140 @@
+// Networking
+
+#define NET_DEFAULT_PORT 27960
+#define NET_MAX_PACKET_SIZE 1200
+
+// Inputs the client remembers until the server has processed them. Every
+// packet repeats all of them the server hasn't acknowledged, up to the
+// packet limit, so inputs are only lost if acks stop for that long.
+#define NET_INPUT_HISTORY 128
+#define NET_INPUTS_PER_PACKET NET_INPUT_HISTORY
+
+// Snapshots each side remembers to encode and decode deltas against
+#define NET_SNAPSHOT_HISTORY 64
+#define NET_MAX_ENTITIES 16
+
+// Quantization steps
+#define NET_POSITION_STEPS_PER_METER 4096.0f
+#define NET_VELOCITY_STEPS_PER_METER 1024.0f
+#define NET_MOVE_STEPS 127.0f
+#define NET_DT_STEPS_PER_SECOND 10000.0f
+
+enum NetPacketType
+{
+        NetPacket_Input    = 1,
+        NetPacket_Snapshot = 2,
+};
+
+// Fields of an entity, in encoding order. Each has a bit in the
+// per-entity change mask of a snapshot, which holds at most 8. Tile
+// coordinates are split into their low and high 32 bits; the high half
+// almost never changes, so it costs nothing in deltas.
+enum NetEntityField
+{
+        NetEntityField_TileX,
+        NetEntityField_TileY,
+        NetEntityField_RelativeX,
+        NetEntityField_RelativeY,
+        NetEntityField_VelocityX,
+        NetEntityField_VelocityY,
+        NetEntityField_TileXHigh,
+        NetEntityField_TileYHigh,
+
+        NetEntityField_Count,
+};
+
+struct NetAddress
+{
+        uint32 host; // host byte order
+        uint16 port;
+};
+
+struct NetSocket
+{
+        int32 handle;
+
+        // Percentage of outgoing packets to drop, to simulate a bad link
+        uint32 dropPercent;
+        uint32 dropSeed;
+};
+
+struct InputCommand
+{
+        uint32 sequence;
+        int8 moveX;
+        int8 moveY;
+        uint16 dt;
+};
+
+// Quantized entity state. Every field is an integer so that deltas
+// are exact and the server and client agree bit for bit.
+struct NetEntityState
+{
+        int32 fields[NetEntityField_Count];
+};
+
+struct NetSnapshot
+{
+        uint32 sequence;
+        uint32 entityCount;
+        NetEntityState entities[NET_MAX_ENTITIES];
+};
+
+struct NetStats
+{
+        uint32 ticks;
+        uint32 bytesSent;
+        uint32 bytesReceived;
+        uint32 packetsSent;
+        uint32 packetsReceived;
+        uint32 fullSnapshots;
+        uint32 deltaSnapshots;
+
+        // Input commands the server skipped because none of the packets
+        // carrying them arrived
+        uint32 inputsLost;
+
+        uint32 rttSamples;
+        real64 rttSum;
+        real64 rttMax;
+};
+
+struct NetServer
+{
+        NetSocket socket;
+
+        bool32 hasClient;
+        NetAddress client;
+        uint32 lastProcessedInput;
+        uint32 lastClientTime;
+
+        uint32 snapshotSequence;
+        uint32 ackedSnapshot;
+        NetSnapshot sent[NET_SNAPSHOT_HISTORY];
+
+        TileMap tileMap;
+        World world;
+        GameState gameState;
+
+        NetStats stats;
+        uint32 tickMilliseconds;
+        SDL_atomic_t quit;
+};
+
+struct NetClient
+{
+        NetSocket socket;
+        NetAddress server;
+
+        InputCommand inputs[NET_INPUT_HISTORY];
+        uint32 nextInput;
+        uint32 lastProcessedInput;
+
+        uint32 latestSnapshot;
+        NetSnapshot received[NET_SNAPSHOT_HISTORY];
+
+        // The local player runs ahead of the server on unacknowledged input
+        GameState predicted;
+
+        NetStats stats;
+};
@@ -0,0 +1,307 @@
+// Particles
+//
+// Particles are stored as a structure of arrays and updated LANE_WIDTH at
+// a time: drag, integration, recanonicalization and aging are all lane
+// operations. Only the particles that cross into another tile touch the
+// tile map, to bounce off walls. Expired particles are swap-removed, so
+// the live ones stay packed at the front of the pool.
+//
+// Tile coordinates are kept as 32 bit offsets from the origin of the
+// system, and are only turned back into world tiles to look up the tile
+// map or to subtract the camera, so they stay exact anywhere in the
+// world.
+
+internal void
+initializeParticleSystem( ParticleSystem* system, uint32 capacity )
+{
+        // Round up to whole lanes
+        uint32 padded = (capacity + LANE_WIDTH - 1) & ~(LANE_WIDTH - 1);
+
+        system->count = 0;
+        system->capacity = capacity;
+        system->tileX = (int32*)calloc( padded, sizeof(int32) );
+        system->tileY = (int32*)calloc( padded, sizeof(int32) );
+        system->relativeX = (real32*)calloc( padded, sizeof(real32) );
+        system->relativeY = (real32*)calloc( padded, sizeof(real32) );
+        system->velocityX = (real32*)calloc( padded, sizeof(real32) );
+        system->velocityY = (real32*)calloc( padded, sizeof(real32) );
+        system->life = (real32*)calloc( padded, sizeof(real32) );
+        system->rects = (SDL_Rect*)malloc( capacity * sizeof(SDL_Rect) );
+
+        system->drag = 2.0f;
+        system->bounce = true;
+        system->restitution = 0.5f;
+        system->sizeInPixels = 3.0f;
+        system->colorR = 0.8f;
+        system->colorG = 0.7f;
+        system->colorB = 0.5f;
+        system->colorA = 1.0f;
+        system->random = 0x9E3779B9;
+}
+
+internal void
+freeParticleSystem( ParticleSystem* system )
+{
+        free( system->tileX );
+        free( system->tileY );
+        free( system->relativeX );
+        free( system->relativeY );
+        free( system->velocityX );
+        free( system->velocityY );
+        free( system->life );
+        free( system->rects );
+        *system = {};
+}
+
+// Uniform in [0, 1)
+inline real32
+randomParticleUnit( ParticleSystem* system )
+{
+        // xorshift32
+        uint32 x = system->random;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        system->random = x;
+
+        real32 result = (real32)(x >> 8) / 16777216.0f;
+        return result;
+}
+
+// Returns false when the pool is full, or position is too far from the
+// particles already alive to share their origin
+internal bool32
+emitParticle( ParticleSystem* system, WorldPosition position, V2 velocity, real32 life )
+{
+        if ( system->count == system->capacity )
+        {
+                return false;
+        }
+        if ( system->count == 0 )
+        {
+                system->originTileX = position.tileX;
+                system->originTileY = position.tileY;
+        }
+
+        int64 offsetX = position.tileX - system->originTileX;
+        int64 offsetY = position.tileY - system->originTileY;
+        if ( offsetX < -PARTICLE_MAX_TILE_OFFSET || offsetX > PARTICLE_MAX_TILE_OFFSET ||
+             offsetY < -PARTICLE_MAX_TILE_OFFSET || offsetY > PARTICLE_MAX_TILE_OFFSET )
+        {
+                return false;
+        }
+
+        uint32 i = system->count++;
+        system->tileX[i] = (int32)offsetX;
+        system->tileY[i] = (int32)offsetY;
+        system->relativeX[i] = position.relative.x;
+        system->relativeY[i] = position.relative.y;
+        system->velocityX[i] = velocity.x;
+        system->velocityY[i] = velocity.y;
+        system->life[i] = life;
+
+        return true;
+}
+
+// count particles flying out of position in random directions, with
+// speeds up to speed and lives up to life
+internal void
+emitParticleBurst( ParticleSystem* system, WorldPosition position,
+                   uint32 count, real32 speed, real32 life )
+{
+        real32 tau = 2.0f * 3.14159265f;
+        for ( uint32 i = 0; i < count; ++i )
+        {
+                real32 angle = tau * randomParticleUnit( system );
+                real32 particleSpeed = speed * (0.25f + 0.75f * randomParticleUnit( system ));
+                V2 velocity = { particleSpeed * cosf( angle ), particleSpeed * sinf( angle ) };
+                real32 particleLife = life * (0.5f + 0.5f * randomParticleUnit( system ));
+                if ( !emitParticle( system, position, velocity, particleLife ) )
+                {
+                        break;
+                }
+        }
+}
+
+inline void
+copyParticle( ParticleSystem* system, uint32 dest, uint32 source )
+{
+        system->tileX[dest] = system->tileX[source];
+        system->tileY[dest] = system->tileY[source];
+        system->relativeX[dest] = system->relativeX[source];
+        system->relativeY[dest] = system->relativeY[source];
+        system->velocityX[dest] = system->velocityX[source];
+        system->velocityY[dest] = system->velocityY[source];
+        system->life[dest] = system->life[source];
+}
+
+// The particle at index just moved out of the tile it was in at before,
+// both relative to the origin of the system. If it moved into a wall,
+// undo the move along the axis that hit and reflect the velocity on it.
+internal void
+bounceParticle( ParticleSystem* system, World* world, uint32 index, WorldPosition before )
+{
+        WorldPosition after;
+        after.tileX = system->originTileX + system->tileX[index];
+        after.tileY = system->originTileY + system->tileY[index];
+        after.relative = { system->relativeX[index], system->relativeY[index] };
+        before.tileX += system->originTileX;
+        before.tileY += system->originTileY;
+
+        WorldPosition acrossX = before;
+        acrossX.tileX = after.tileX;
+        WorldPosition acrossY = before;
+        acrossY.tileY = after.tileY;
+
+        bool32 hitX = after.tileX != before.tileX && !isTileEmpty( world, acrossX );
+        bool32 hitY = after.tileY != before.tileY && !isTileEmpty( world, acrossY );
+        if ( !hitX && !hitY && !isTileEmpty( world, after ) )
+        {
+                // Straight into a corner
+                hitX = true;
+                hitY = true;
+        }
+
+        if ( hitX )
+        {
+                system->tileX[index] = (int32)(before.tileX - system->originTileX);
+                system->relativeX[index] = before.relative.x;
+                system->velocityX[index] *= -system->restitution;
+        }
+        if ( hitY )
+        {
+                system->tileY[index] = (int32)(before.tileY - system->originTileY);
+                system->relativeY[index] = before.relative.y;
+                system->velocityY[index] *= -system->restitution;
+        }
+}
+
+internal void
+updateParticles( ParticleSystem* system, World* world, real32 dt )
+{
+        real32 damping = 1.0f - system->drag * dt;
+        if ( damping < 0.0f )
+        {
+                damping = 0.0f;
+        }
+        LaneR32 dtLanes = laneR32( dt );
+
+        for ( uint32 base = 0; base < system->count; base += LANE_WIDTH )
+        {
+                LaneWorldPosition before;
+                before.tileX = loadLaneI32( system->tileX + base );
+                before.tileY = loadLaneI32( system->tileY + base );
+                before.relative.x = loadLaneR32( system->relativeX + base );
+                before.relative.y = loadLaneR32( system->relativeY + base );
+
+                LaneV2 velocity;
+                velocity.x = damping * loadLaneR32( system->velocityX + base );
+                velocity.y = damping * loadLaneR32( system->velocityY + base );
+
+                LaneWorldPosition after = before;
+                after.relative += dtLanes * velocity;
+                after = recanonicalizeLanes( world, after );
+
+                storeLaneI32( system->tileX + base, after.tileX );
+                storeLaneI32( system->tileY + base, after.tileY );
+                storeLaneR32( system->relativeX + base, after.relative.x );
+                storeLaneR32( system->relativeY + base, after.relative.y );
+                storeLaneR32( system->velocityX + base, velocity.x );
+                storeLaneR32( system->velocityY + base, velocity.y );
+                storeLaneR32( system->life + base, loadLaneR32( system->life + base ) - dtLanes );
+
+                if ( system->bounce )
+                {
+                        LaneMask moved = !((after.tileX == before.tileX) & (after.tileY == before.tileY));
+                        uint32 movedLanes = getLaneBits( moved );
+                        for ( uint32 lane = 0; movedLanes; ++lane, movedLanes >>= 1 )
+                        {
+                                if ( (movedLanes & 1) && base + lane < system->count )
+                                {
+                                        bounceParticle( system, world, base + lane, getLane( before, lane ) );
+                                }
+                        }
+                }
+        }
+
+        for ( uint32 i = 0; i < system->count; )
+        {
+                if ( system->life[i] <= 0.0f )
+                {
+                        copyParticle( system, i, --system->count );
+                }
+                else
+                {
+                        ++i;
+                }
+        }
+}
+
+// Draw every particle on screen with a single SDL_RenderFillRects
+internal void
+drawParticles( SDL_Renderer* renderer, ParticleSystem* system, World* world, Camera camera )
+{
+        real32 tilePixels = world->tileSideInPixels;
+        real32 metersToPixels = world->metersToPixels;
+        real32 tileRadius = 0.5f * world->tileSideInMeters;
+        real32 size = system->sizeInPixels;
+        int32 sizeInPixels = (int32)size;
+
+        // Screen position of a particle, as in getScreenCoordinates, with
+        // the same half tile offset that draw() gives the player, then
+        // moved to the top left of its square
+        LaneR32 offsetX = laneR32( (tileRadius - camera.position.relative.x) * metersToPixels - 0.5f * size );
+        LaneR32 offsetY = laneR32( SCREEN_HEIGHT - (tileRadius - camera.position.relative.y) * metersToPixels - 0.5f * size );
+
+        LaneR32 lowest = laneR32( -size );
+        LaneR32 screenWidth = laneR32( SCREEN_WIDTH );
+        LaneR32 screenHeight = laneR32( SCREEN_HEIGHT );
+
+        // A camera this far from the particles can't see any of them, and
+        // its offset wouldn't fit in the lanes
+        int64 cameraOffsetX = camera.position.tileX - system->originTileX;
+        int64 cameraOffsetY = camera.position.tileY - system->originTileY;
+        if ( cameraOffsetX < -PARTICLE_MAX_TILE_OFFSET || cameraOffsetX > PARTICLE_MAX_TILE_OFFSET ||
+             cameraOffsetY < -PARTICLE_MAX_TILE_OFFSET || cameraOffsetY > PARTICLE_MAX_TILE_OFFSET )
+        {
+                return;
+        }
+        LaneI32 cameraTileX = laneI32( (int32)cameraOffsetX );
+        LaneI32 cameraTileY = laneI32( (int32)cameraOffsetY );
+
+        uint32 rectCount = 0;
+        for ( uint32 base = 0; base < system->count; base += LANE_WIDTH )
+        {
+                LaneR32 tileX = convertToReal32( loadLaneI32( system->tileX + base ) - cameraTileX );
+                LaneR32 tileY = convertToReal32( loadLaneI32( system->tileY + base ) - cameraTileY );
+                LaneR32 x = tilePixels * tileX + metersToPixels * loadLaneR32( system->relativeX + base ) + offsetX;
+                LaneR32 y = offsetY - (tilePixels * tileY + metersToPixels * loadLaneR32( system->relativeY + base ));
+
+                LaneMask visible = (x > lowest) & (x < screenWidth) & (y > lowest) & (y < screenHeight);
+                uint32 visibleLanes = getLaneBits( visible );
+                if ( visibleLanes == 0 )
+                {
+                        continue;
+                }
+
+                int32 screenX[LANE_WIDTH];
+                int32 screenY[LANE_WIDTH];
+                storeLaneI32( screenX, truncateReal32ToInt32( x ) );
+                storeLaneI32( screenY, truncateReal32ToInt32( y ) );
+                for ( uint32 lane = 0; visibleLanes; ++lane, visibleLanes >>= 1 )
+                {
+                        if ( (visibleLanes & 1) && base + lane < system->count )
+                        {
+                                SDL_Rect rect = { screenX[lane], screenY[lane], sizeInPixels, sizeInPixels };
+                                system->rects[ rectCount++ ] = rect;
+                        }
+                }
+        }
+
+        if ( rectCount )
+        {
+                setRenderDrawColor( renderer, system->colorR, system->colorG,
+                                    system->colorB, system->colorA );
+                SDL_RenderFillRects( renderer, system->rects, rectCount );
+        }
+}
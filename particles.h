@@ -0,0 +1,49 @@
+// Particles
+
+// Particles further than this many tiles from the origin of their
+// system aren't emitted. Leaves room for particles to drift and for
+// the difference of two offsets to fit in 32 bits.
+#define PARTICLE_MAX_TILE_OFFSET (1 << 29)
+
+// Fields of every particle, one array each (structure of arrays). The
+// live particles are packed at the front; arrays are padded to a whole
+// number of lanes, so the last lane can always be loaded and stored.
+struct ParticleSystem
+{
+        uint32 count;
+        uint32 capacity;
+
+        // Tiles are stored relative to this tile so that they fit in 32
+        // bit lanes. It moves to wherever the next particle is emitted
+        // whenever the system is empty.
+        int64 originTileX;
+        int64 originTileY;
+
+        int32* tileX;
+        int32* tileY;
+        real32* relativeX;
+        real32* relativeY;
+        real32* velocityX;
+        real32* velocityY;
+        real32* life; // seconds left
+
+        // Fraction of velocity lost per second
+        real32 drag;
+
+        // Bounce off tiles that aren't empty, keeping this much of the
+        // speed. Particles pass through walls when bounce is off.
+        bool32 bounce;
+        real32 restitution;
+
+        // Every particle is drawn as one square of this color
+        real32 sizeInPixels;
+        real32 colorR, colorG, colorB, colorA;
+
+        // Filled in by drawParticles and submitted in one call
+        SDL_Rect* rects;
+
+        uint32 random;
+};
+
+// In particles.cpp, which comes after draw() in the build
+internal void drawParticles( SDL_Renderer* renderer, ParticleSystem* system, World* world, Camera camera );
@@ -0,0 +1,278 @@
+// Raycasting
+//
+// Rays walk the tile grid with Amanatides-Woo DDA: every step crosses
+// into whichever neighbouring tile the ray reaches first, so each tile
+// along the ray is visited once. The walk keeps its own chunk and
+// in-chunk coordinates and only looks up a new chunk when it steps out
+// of the current one, instead of going through getTileValue (and its
+// chunk lookup) for every tile. Distances are measured from the origin
+// tile, so the float math stays small however far the ray is from the
+// world origin.
+
+internal RayHit
+castRay( World* world, Ray ray )
+{
+        TileMap* tileMap = world->tileMap;
+        real32 tileSize = world->tileSideInMeters;
+        real32 tileRadius = 0.5f * tileSize;
+
+        RayHit hit = {};
+        WorldPosition origin = recanonicalizePosition( world, ray.origin );
+
+        // A zero or non-finite direction only looks at the origin tile
+        V2 direction = {};
+        real32 length = sqrtf( square( ray.direction.x ) + square( ray.direction.y ) );
+        bool32 canStep = (length > 0.0f && length < INFINITY);
+        if ( canStep )
+        {
+                direction = (1.0f / length) * ray.direction;
+        }
+
+        // NaN compares false against everything, so it would never stop
+        real32 maxDistance = ray.maxDistance;
+        if ( !(maxDistance >= 0.0f) )
+        {
+                maxDistance = 0.0f;
+        }
+
+        // Offset within the origin tile, from its lower left corner
+        real32 x = origin.relative.x + tileRadius;
+        real32 y = origin.relative.y + tileRadius;
+
+        // Distance along the ray to the next vertical and horizontal tile
+        // edges, and between consecutive ones
+        int32 stepX = 0;
+        int32 stepY = 0;
+        real32 nextX = INFINITY;
+        real32 nextY = INFINITY;
+        real32 deltaX = INFINITY;
+        real32 deltaY = INFINITY;
+        if ( direction.x > 0.0f )
+        {
+                stepX = 1;
+                deltaX = tileSize / direction.x;
+                nextX = (tileSize - x) / direction.x;
+        }
+        else if ( direction.x < 0.0f )
+        {
+                stepX = -1;
+                deltaX = tileSize / -direction.x;
+                nextX = x / -direction.x;
+        }
+        if ( direction.y > 0.0f )
+        {
+                stepY = 1;
+                deltaY = tileSize / direction.y;
+                nextY = (tileSize - y) / direction.y;
+        }
+        else if ( direction.y < 0.0f )
+        {
+                stepY = -1;
+                deltaY = tileSize / -direction.y;
+                nextY = y / -direction.y;
+        }
+
+        int64 tileX = origin.tileX;
+        int64 tileY = origin.tileY;
+
+        uint32 chunkDim = tileMap->chunkDim;
+        uint32 chunkMask = tileMap->chunkMask;
+        uint32 chunkShift = tileMap->chunkShift;
+        uint32 localX = (uint32)tileX & chunkMask;
+        uint32 localY = (uint32)tileY & chunkMask;
+        TileChunk* chunk = getTileChunk( tileMap, tileX >> chunkShift, tileY >> chunkShift );
+
+        real32 distance = 0.0f;
+        V2 normal = {};
+        for ( uint32 stepCount = 0; ; ++stepCount )
+        {
+                uint32 tileValue = 2;
+                if ( chunk )
+                {
+                        tileValue = chunk->tiles[ localY * chunkDim + localX ];
+                }
+                if ( tileValue != 0 )
+                {
+                        hit.hit = true;
+                        hit.tileX = tileX;
+                        hit.tileY = tileY;
+                        hit.tileValue = tileValue;
+                        break;
+                }
+                if ( !canStep || stepCount == RAYCAST_MAX_STEPS )
+                {
+                        break;
+                }
+
+                if ( nextX < nextY )
+                {
+                        if ( nextX > maxDistance )
+                        {
+                                break;
+                        }
+                        distance = nextX;
+                        nextX += deltaX;
+                        tileX += stepX;
+                        normal = { (real32)-stepX, 0.0f };
+
+                        localX += stepX;
+                        if ( localX >= chunkDim )
+                        {
+                                localX &= chunkMask;
+                                chunk = getTileChunk( tileMap, tileX >> chunkShift, tileY >> chunkShift );
+                        }
+                }
+                else
+                {
+                        if ( nextY > maxDistance )
+                        {
+                                break;
+                        }
+                        distance = nextY;
+                        nextY += deltaY;
+                        tileY += stepY;
+                        normal = { 0.0f, (real32)-stepY };
+
+                        localY += stepY;
+                        if ( localY >= chunkDim )
+                        {
+                                localY &= chunkMask;
+                                chunk = getTileChunk( tileMap, tileX >> chunkShift, tileY >> chunkShift );
+                        }
+                }
+        }
+
+        if ( hit.hit )
+        {
+                hit.distance = distance;
+                hit.normal = normal;
+                hit.point = origin;
+                hit.point.relative += distance * direction;
+                hit.point = recanonicalizePosition( world, hit.point );
+        }
+
+        return hit;
+}
+
+internal void
+castRays( World* world, Ray* rays, RayHit* hits, uint32 count )
+{
+        for ( uint32 i = 0; i < count; ++i )
+        {
+                hits[i] = castRay( world, rays[i] );
+        }
+}
+
+// Take blocks of rays until the batch runs out
+internal void
+drainRaycastBatch( RaycastBatch* batch )
+{
+        for ( ;; )
+        {
+                uint32 first = (uint32)SDL_AtomicAdd( &batch->nextRay, RAYCAST_BLOCK_SIZE );
+                if ( first >= batch->count )
+                {
+                        break;
+                }
+                uint32 count = batch->count - first;
+                if ( count > RAYCAST_BLOCK_SIZE )
+                {
+                        count = RAYCAST_BLOCK_SIZE;
+                }
+                castRays( batch->world, batch->rays + first, batch->hits + first, count );
+        }
+}
+
+internal int32
+raycastThreadProc( void* data )
+{
+        RaycastWorkers* workers = (RaycastWorkers*)data;
+        for ( ;; )
+        {
+                SDL_SemWait( workers->start );
+                if ( SDL_AtomicGet( &workers->quit ) )
+                {
+                        break;
+                }
+                drainRaycastBatch( &workers->batch );
+                SDL_SemPost( workers->finished );
+        }
+        return 0;
+}
+
+// threadCount helpers on top of the calling thread. 0 means one for
+// every other CPU.
+internal void
+startRaycastWorkers( RaycastWorkers* workers, uint32 threadCount )
+{
+        if ( threadCount == 0 )
+        {
+                int32 cpuCount = SDL_GetCPUCount();
+                threadCount = cpuCount > 1 ? (uint32)(cpuCount - 1) : 0;
+        }
+        if ( threadCount > RAYCAST_MAX_THREADS )
+        {
+                threadCount = RAYCAST_MAX_THREADS;
+        }
+
+        workers->start = SDL_CreateSemaphore( 0 );
+        workers->finished = SDL_CreateSemaphore( 0 );
+        SDL_AtomicSet( &workers->quit, 0 );
+
+        workers->threadCount = 0;
+        for ( uint32 i = 0; i < threadCount; ++i )
+        {
+                SDL_Thread* thread = SDL_CreateThread( raycastThreadProc, "Raycast", workers );
+                if ( !thread )
+                {
+                        break;
+                }
+                workers->threads[ workers->threadCount++ ] = thread;
+        }
+}
+
+internal void
+stopRaycastWorkers( RaycastWorkers* workers )
+{
+        SDL_AtomicSet( &workers->quit, 1 );
+        for ( uint32 i = 0; i < workers->threadCount; ++i )
+        {
+                SDL_SemPost( workers->start );
+        }
+        for ( uint32 i = 0; i < workers->threadCount; ++i )
+        {
+                SDL_WaitThread( workers->threads[i], NULL );
+        }
+        SDL_DestroySemaphore( workers->start );
+        SDL_DestroySemaphore( workers->finished );
+        workers->threadCount = 0;
+}
+
+// Cast every ray, split over the workers and the calling thread. Returns
+// once all the hits are written.
+internal void
+castRaysParallel( RaycastWorkers* workers, World* world, Ray* rays, RayHit* hits, uint32 count )
+{
+        if ( workers->threadCount == 0 || count <= RAYCAST_BLOCK_SIZE )
+        {
+                castRays( world, rays, hits, count );
+                return;
+        }
+
+        RaycastBatch* batch = &workers->batch;
+        batch->world = world;
+        batch->rays = rays;
+        batch->hits = hits;
+        batch->count = count;
+        SDL_AtomicSet( &batch->nextRay, 0 );
+
+        for ( uint32 i = 0; i < workers->threadCount; ++i )
+        {
+                SDL_SemPost( workers->start );
+        }
+        drainRaycastBatch( batch );
+        for ( uint32 i = 0; i < workers->threadCount; ++i )
+        {
+                SDL_SemWait( workers->finished );
+        }
+}
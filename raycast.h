@@ -0,0 +1,58 @@
+// Raycasting
+
+#define RAYCAST_MAX_THREADS 16
+
+// Rays are handed to threads this many at a time
+#define RAYCAST_BLOCK_SIZE 64
+
+// No ray walks more tiles than this, so a ray with an infinite
+// maxDistance can't stall the frame
+#define RAYCAST_MAX_STEPS (1 << 20)
+
+struct Ray
+{
+        WorldPosition origin;
+        V2 direction; // need not be normalized
+        real32 maxDistance; // meters, may be INFINITY
+};
+
+struct RayHit
+{
+        bool32 hit;
+
+        // The first tile that isn't empty. Tiles that were never set count
+        // as solid (value 2, as getTileValue returns).
+        int64 tileX;
+        int64 tileY;
+        uint32 tileValue;
+
+        // Where the ray enters the tile, the normal of the face it enters
+        // through, and how far along the ray that is. A ray that starts
+        // inside a solid tile hits at distance 0 with a zero normal.
+        WorldPosition point;
+        V2 normal;
+        real32 distance;
+};
+
+struct RaycastBatch
+{
+        World* world;
+        Ray* rays;
+        RayHit* hits;
+        uint32 count;
+        SDL_atomic_t nextRay;
+};
+
+// Threads that help with castRaysParallel. They sleep on a semaphore
+// between batches.
+struct RaycastWorkers
+{
+        SDL_Thread* threads[RAYCAST_MAX_THREADS];
+        uint32 threadCount;
+
+        SDL_sem* start;
+        SDL_sem* finished;
+        SDL_atomic_t quit;
+
+        RaycastBatch batch;
+};
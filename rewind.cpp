@@ -0,0 +1,331 @@
+// Rewind
+//
+// Keeps the last frames of the simulation in memory. Each frame stores
+// the player and camera, plus a record for every tile chunk that changed
+// since the frame before it: the chunk before and after the change.
+// Chunks are shared with the live world by reference count, so a chunk
+// is only duplicated when the world writes to it after it was recorded
+// (see makeTileChunkWritable). That copy also lists the chunk in the
+// tile map's dirtyChunks, so recording a frame only looks at the chunks
+// that changed in it. Stepping one frame back or forward swaps in the
+// chunks recorded for that frame, so it too costs only as much as what
+// changed in it.
+
+inline RewindFrame*
+getRewindFrame( RewindBuffer* rewind, uint32 index )
+{
+        RewindFrame* result = &rewind->frames[ (rewind->firstFrame + index) % rewind->frameCapacity ];
+        return result;
+}
+
+inline ChunkRecord*
+getChunkRecord( RewindBuffer* rewind, uint64 absoluteIndex )
+{
+        ChunkRecord* result = &rewind->records[ absoluteIndex % rewind->recordCapacity ];
+        return result;
+}
+
+inline void
+releaseChunkRecord( ChunkRecord* record )
+{
+        releaseTileChunk( record->before );
+        releaseTileChunk( record->after );
+}
+
+// Make the current state the only frame in the history
+internal void
+startRewindHistory( RewindBuffer* rewind, GameState* gameState )
+{
+        TileMap* tileMap = rewind->world->tileMap;
+        for ( uint32 chunkIndex = 0; chunkIndex < rewind->chunkCount; ++chunkIndex )
+        {
+                rewind->recorded[chunkIndex] = tileMap->tileChunks[chunkIndex];
+                retainTileChunk( rewind->recorded[chunkIndex] );
+        }
+
+        rewind->dirtyChunks.count = 0;
+        rewind->firstFrame = 0;
+        rewind->frameCount = 1;
+        rewind->cursor = 0;
+        rewind->firstRecord = 0;
+        rewind->nextRecord = 0;
+
+        RewindFrame* frame = getRewindFrame( rewind, 0 );
+        frame->player = gameState->player;
+        frame->camera = gameState->camera;
+        frame->firstRecord = 0;
+        frame->recordCount = 0;
+}
+
+internal void
+clearRewindHistory( RewindBuffer* rewind )
+{
+        for ( uint64 index = rewind->firstRecord; index < rewind->nextRecord; ++index )
+        {
+                releaseChunkRecord( getChunkRecord( rewind, index ) );
+        }
+        for ( uint32 chunkIndex = 0; chunkIndex < rewind->chunkCount; ++chunkIndex )
+        {
+                releaseTileChunk( rewind->recorded[chunkIndex] );
+        }
+        rewind->frameCount = 0;
+        rewind->firstRecord = 0;
+        rewind->nextRecord = 0;
+}
+
+// Keep up to frameCapacity frames (at least two) of gameState. Records
+// are sized so that the frames and the chunks only they keep alive stay
+// within memoryBudget bytes; the oldest frames are dropped first.
+internal void
+initializeRewindBuffer( RewindBuffer* rewind,
+                        GameState* gameState,
+                        uint32 frameCapacity,
+                        uint64 memoryBudget )
+{
+        World* world = gameState->world;
+        TileMap* tileMap = world->tileMap;
+
+        if ( frameCapacity < 2 )
+        {
+                frameCapacity = 2;
+        }
+
+        uint64 frameBytes = (uint64)frameCapacity * sizeof(RewindFrame);
+        uint64 recordBytes = memoryBudget > frameBytes ? memoryBudget - frameBytes : 0;
+        uint64 chunkBytes = (1 + getTileChunkTileCount( tileMap )) * sizeof(uint32);
+        uint64 recordCapacity = recordBytes / (chunkBytes + sizeof(ChunkRecord));
+        if ( recordCapacity < 1 )
+        {
+                recordCapacity = 1;
+        }
+
+        rewind->world = world;
+        rewind->frameCapacity = frameCapacity;
+        rewind->frames = (RewindFrame*)malloc( frameCapacity * sizeof(RewindFrame) );
+        rewind->recordCapacity = (uint32)recordCapacity;
+        rewind->records = (ChunkRecord*)malloc( rewind->recordCapacity * sizeof(ChunkRecord) );
+        rewind->chunkCount = getTileChunkCount( tileMap );
+        rewind->recorded = (TileChunk*)malloc( rewind->chunkCount * sizeof(TileChunk) );
+
+        rewind->unsetChunk = allocateTileChunk( tileMap, 0, 0 );
+        uint32 chunkTileCount = getTileChunkTileCount( tileMap );
+        for ( uint32 tileIndex = 0; tileIndex < chunkTileCount; ++tileIndex )
+        {
+                rewind->unsetChunk.tiles[tileIndex] = 2;
+        }
+
+        rewind->dirtyChunks = {};
+        tileMap->dirtyChunks = &rewind->dirtyChunks;
+
+        startRewindHistory( rewind, gameState );
+}
+
+internal void
+freeRewindBuffer( RewindBuffer* rewind )
+{
+        clearRewindHistory( rewind );
+        releaseTileChunk( rewind->unsetChunk );
+        rewind->world->tileMap->dirtyChunks = 0;
+        free( rewind->dirtyChunks.chunkIndices );
+        free( rewind->frames );
+        free( rewind->records );
+        free( rewind->recorded );
+        rewind->dirtyChunks = {};
+        rewind->frames = 0;
+        rewind->records = 0;
+        rewind->recorded = 0;
+}
+
+// Start over from gameState after its world was replaced, e.g. by a
+// snapshot load, since the recorded chunk indices no longer apply
+internal void
+resetRewindBuffer( RewindBuffer* rewind, GameState* gameState )
+{
+        clearRewindHistory( rewind );
+        rewind->chunkCount = getTileChunkCount( rewind->world->tileMap );
+        rewind->recorded = (TileChunk*)realloc( rewind->recorded, rewind->chunkCount * sizeof(TileChunk) );
+        startRewindHistory( rewind, gameState );
+}
+
+// Forget the frames after the cursor, they are about to be overwritten
+internal void
+dropNewestFrames( RewindBuffer* rewind )
+{
+        while ( rewind->frameCount - 1 > rewind->cursor )
+        {
+                RewindFrame* frame = getRewindFrame( rewind, rewind->frameCount - 1 );
+                for ( uint32 i = 0; i < frame->recordCount; ++i )
+                {
+                        releaseChunkRecord( getChunkRecord( rewind, frame->firstRecord + i ) );
+                }
+                rewind->nextRecord -= frame->recordCount;
+                --rewind->frameCount;
+        }
+}
+
+// The oldest frame never needs its records, since there is nothing
+// before it to step back to. Dropping it frees the records of the frame
+// that takes its place.
+internal void
+dropOldestFrame( RewindBuffer* rewind )
+{
+        assert( rewind->frameCount > 1 && rewind->cursor > 0 );
+
+        rewind->firstFrame = (rewind->firstFrame + 1) % rewind->frameCapacity;
+        --rewind->frameCount;
+        --rewind->cursor;
+
+        RewindFrame* oldest = getRewindFrame( rewind, 0 );
+        for ( uint32 i = 0; i < oldest->recordCount; ++i )
+        {
+                releaseChunkRecord( getChunkRecord( rewind, oldest->firstRecord + i ) );
+        }
+        rewind->firstRecord += oldest->recordCount;
+        oldest->recordCount = 0;
+}
+
+// Chunks created since the last frame are recorded as if they had been
+// there all along with every tile unset, so that they get a record like
+// any other changed chunk and stepping back past the frame that created
+// them unsets their tiles again. They all share the tiles of unsetChunk.
+internal void
+recordNewTileChunks( RewindBuffer* rewind )
+{
+        TileMap* tileMap = rewind->world->tileMap;
+        uint32 chunkCount = getTileChunkCount( tileMap );
+        if ( chunkCount > rewind->chunkCount )
+        {
+                rewind->recorded = (TileChunk*)realloc( rewind->recorded, chunkCount * sizeof(TileChunk) );
+                for ( uint32 chunkIndex = rewind->chunkCount; chunkIndex < chunkCount; ++chunkIndex )
+                {
+                        TileChunk unset = rewind->unsetChunk;
+                        unset.chunkX = tileMap->tileChunks[chunkIndex].chunkX;
+                        unset.chunkY = tileMap->tileChunks[chunkIndex].chunkY;
+                        rewind->recorded[chunkIndex] = unset;
+                        retainTileChunk( unset );
+                }
+                rewind->chunkCount = chunkCount;
+        }
+}
+
+// Append gameState as the newest frame. Called after every update.
+internal void
+recordRewindFrame( RewindBuffer* rewind, GameState* gameState )
+{
+        TileMap* tileMap = rewind->world->tileMap;
+        TileChunk* tileChunks = tileMap->tileChunks;
+        TileChunkList* dirtyChunks = &rewind->dirtyChunks;
+
+        dropNewestFrames( rewind );
+        recordNewTileChunks( rewind );
+
+        // A chunk shared again after its first copy, e.g. by a save, is
+        // listed twice, which only makes room for one record too many
+        uint32 changedCount = 0;
+        for ( uint32 i = 0; i < dirtyChunks->count; ++i )
+        {
+                uint32 chunkIndex = dirtyChunks->chunkIndices[i];
+                if ( tileChunks[chunkIndex].tiles != rewind->recorded[chunkIndex].tiles )
+                {
+                        ++changedCount;
+                }
+        }
+
+        // A change too big for the budget can't be stepped over, so the
+        // history restarts from here
+        if ( changedCount > rewind->recordCapacity )
+        {
+                clearRewindHistory( rewind );
+                startRewindHistory( rewind, gameState );
+                return;
+        }
+
+        while ( rewind->frameCount == rewind->frameCapacity ||
+                (rewind->nextRecord - rewind->firstRecord) + changedCount > rewind->recordCapacity )
+        {
+                dropOldestFrame( rewind );
+        }
+
+        RewindFrame* frame = getRewindFrame( rewind, rewind->frameCount );
+        frame->player = gameState->player;
+        frame->camera = gameState->camera;
+        frame->firstRecord = rewind->nextRecord;
+        frame->recordCount = 0;
+
+        for ( uint32 i = 0; i < dirtyChunks->count; ++i )
+        {
+                uint32 chunkIndex = dirtyChunks->chunkIndices[i];
+                TileChunk live = tileChunks[chunkIndex];
+                if ( live.tiles != rewind->recorded[chunkIndex].tiles )
+                {
+                        ChunkRecord* record = getChunkRecord( rewind, rewind->nextRecord++ );
+                        record->chunkIndex = chunkIndex;
+                        // The reference held by recorded moves to the record
+                        record->before = rewind->recorded[chunkIndex];
+                        record->after = live;
+                        retainTileChunk( live );
+
+                        rewind->recorded[chunkIndex] = live;
+                        retainTileChunk( live );
+                        ++frame->recordCount;
+                }
+        }
+        dirtyChunks->count = 0;
+
+        ++rewind->frameCount;
+        rewind->cursor = rewind->frameCount - 1;
+}
+
+// Restore the frame at index, counted from the oldest frame held
+internal void
+rewindToFrame( RewindBuffer* rewind, GameState* gameState, uint32 index )
+{
+        TileChunk* tileChunks = rewind->world->tileMap->tileChunks;
+
+        if ( index >= rewind->frameCount )
+        {
+                index = rewind->frameCount - 1;
+        }
+
+        while ( rewind->cursor > index )
+        {
+                RewindFrame* frame = getRewindFrame( rewind, rewind->cursor );
+                for ( uint32 i = frame->recordCount; i > 0; --i )
+                {
+                        ChunkRecord* record = getChunkRecord( rewind, frame->firstRecord + i - 1 );
+                        replaceTileChunk( &tileChunks[record->chunkIndex], record->before );
+                        replaceTileChunk( &rewind->recorded[record->chunkIndex], record->before );
+                }
+                --rewind->cursor;
+        }
+        while ( rewind->cursor < index )
+        {
+                ++rewind->cursor;
+                RewindFrame* frame = getRewindFrame( rewind, rewind->cursor );
+                for ( uint32 i = 0; i < frame->recordCount; ++i )
+                {
+                        ChunkRecord* record = getChunkRecord( rewind, frame->firstRecord + i );
+                        replaceTileChunk( &tileChunks[record->chunkIndex], record->after );
+                        replaceTileChunk( &rewind->recorded[record->chunkIndex], record->after );
+                }
+        }
+
+        RewindFrame* frame = getRewindFrame( rewind, rewind->cursor );
+        gameState->player = frame->player;
+        gameState->camera = frame->camera;
+}
+
+internal void
+stepRewindBack( RewindBuffer* rewind, GameState* gameState )
+{
+        if ( rewind->cursor > 0 )
+        {
+                rewindToFrame( rewind, gameState, rewind->cursor - 1 );
+        }
+}
+
+internal void
+stepRewindForward( RewindBuffer* rewind, GameState* gameState )
+{
+        rewindToFrame( rewind, gameState, rewind->cursor + 1 );
+}
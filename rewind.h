@@ -0,0 +1,50 @@
+// Rewind
+
+// A chunk that changed between a frame and the one before it
+struct ChunkRecord
+{
+        uint32 chunkIndex;
+        TileChunk before;
+        TileChunk after;
+};
+
+struct RewindFrame
+{
+        Player player;
+        Camera camera;
+
+        // Absolute index of the first record in the record ring
+        uint64 firstRecord;
+        uint32 recordCount;
+};
+
+struct RewindBuffer
+{
+        World* world;
+
+        // Ring of frames, oldest at firstFrame. The live state matches
+        // the frame at cursor, counted from the oldest.
+        RewindFrame* frames;
+        uint32 frameCapacity;
+        uint32 firstFrame;
+        uint32 frameCount;
+        uint32 cursor;
+
+        // Ring of chunk records. Its capacity is what keeps the history
+        // within the memory budget.
+        ChunkRecord* records;
+        uint32 recordCapacity;
+        uint64 firstRecord;
+        uint64 nextRecord;
+
+        // The chunks as of the frame at cursor
+        TileChunk* recorded;
+        uint32 chunkCount;
+
+        // Every tile 2, what a chunk was before it was created
+        TileChunk unsetChunk;
+
+        // Chunks the world created or copied since the last frame, the
+        // only ones that can differ from recorded
+        TileChunkList dirtyChunks;
+};
@@ -62,9 +62,19 @@ loadSurface( std::string path )
         return loadedSurface;
 }
 
+// Requests made through the keyboard that the main loop acts on
+struct PlatformCommands
+{
+        bool saveSnapshot;
+        bool loadSnapshot;
+        bool rewind;
+        bool rewindForward;
+        bool teleport;
+};
+
 // Handle events on the queue
 bool
-parseEvents()
+parseEvents( PlatformCommands* commands )
 {
         SDL_Event event;
         bool quit = true;
@@ -82,12 +92,66 @@ parseEvents()
                         {
                                 return quit;
                         }
+                        else if ( event.key.keysym.sym == SDLK_F5 )
+                        {
+                                commands->saveSnapshot = true;
+                        }
+                        else if ( event.key.keysym.sym == SDLK_F7 )
+                        {
+                                commands->teleport = true;
+                        }
+                        else if ( event.key.keysym.sym == SDLK_F9 )
+                        {
+                                commands->loadSnapshot = true;
+                        }
                 }
         }
+
+        // Rewind for as long as backspace is held, and replay what was
+        // rewound for as long as the key next to it (=) is held
+        const uint8* keystate = SDL_GetKeyboardState( NULL );
+        commands->rewind = keystate[ SDL_SCANCODE_BACKSPACE ];
+        commands->rewindForward = keystate[ SDL_SCANCODE_EQUALS ];
         
         return !quit;
 }
 
+// Sample the movement keys
+GameInput
+readGameInput()
+{
+        GameInput input = {};
+        const uint8* keystate = SDL_GetKeyboardState( NULL );
+
+        if ( keystate[ SDL_SCANCODE_W ] ) // Up
+        {
+                input.move.y += 1.0f;
+        }
+        if ( keystate[ SDL_SCANCODE_S ] ) // Down
+        {
+                input.move.y += -1.0f;
+        }
+        if ( keystate[ SDL_SCANCODE_A ] ) // Left
+        {
+                input.move.x += -1.0f;
+        }
+        if ( keystate[ SDL_SCANCODE_D ] ) // Right
+        {
+                input.move.x += 1.0f;
+        }
+
+        // if ( keystate[ SDL_SCANCODE_UP ] ) // Zoom in
+        // {
+        //         world->tileSideInPixels += 1.0f;
+        // }
+        // if ( keystate[ SDL_SCANCODE_DOWN ] ) // Zoom out
+        // {
+        //         world->tileSideInPixels -= 1.0f;
+        // }
+
+        return input;
+}
+
 internal void
 setRenderDrawColor( SDL_Renderer* renderer,
                     real32 colorR,
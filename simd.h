@@ -0,0 +1,744 @@
+// SIMD
+//
+// Wide counterparts of V2 and WorldPosition that evaluate 4 (SSE2) or 8
+// (AVX2) lanes at once. Operators mirror the scalar ones in main.h, and
+// the helpers from intrinsics.h are overloaded for the wide types, so
+// the same expression works at any width. Comparisons produce masks
+// instead of bools; use select() to combine lanes.
+//
+// Batched code should use the Lane* types, which resolve at compile time
+// to the widest set the target supports, or to the plain scalar types
+// when there is no SIMD at all (e.g. ARM builds). Define SIMD_SCALAR to
+// force the scalar path, to compare against it.
+//
+// Lane positions have 32 bit tiles, unlike WorldPosition: batched code
+// keeps its tiles as offsets from a 64 bit origin of its own (see
+// ParticleSystem), which also keeps the lanes exact far from the world
+// origin.
+
+#if !defined(SIMD_SCALAR) && (defined(__SSE2__) || defined(_M_X64))
+#define SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+#if !defined(SIMD_SCALAR) && defined(__AVX2__)
+#define SIMD_AVX2 1
+#include <immintrin.h>
+#endif
+
+//
+// Scalar helpers that let lane code also compile at width 1
+//
+
+inline real32
+select( bool32 mask, real32 a, real32 b )
+{
+        real32 result = mask ? a : b;
+        return result;
+}
+
+inline int32
+select( bool32 mask, int32 a, int32 b )
+{
+        int32 result = mask ? a : b;
+        return result;
+}
+
+inline V2
+select( bool32 mask, V2 a, V2 b )
+{
+        V2 result = mask ? a : b;
+        return result;
+}
+
+inline bool32
+anyLanes( bool32 mask )
+{
+        return mask;
+}
+
+inline bool32
+allLanes( bool32 mask )
+{
+        return mask;
+}
+
+inline real32
+convertToReal32( int32 a )
+{
+        real32 result = (real32)a;
+        return result;
+}
+
+#if SIMD_SSE2
+
+//
+// 4 lanes
+//
+
+struct Real32x4
+{
+        __m128 v;
+};
+
+struct Int32x4
+{
+        __m128i v;
+};
+
+// All bits set in lanes where a comparison held
+struct Mask32x4
+{
+        __m128 v;
+};
+
+struct V2x4
+{
+        Real32x4 x, y;
+};
+
+struct WorldPositionx4
+{
+        Int32x4 tileX;
+        Int32x4 tileY;
+        V2x4 relative;
+};
+
+inline Real32x4 real32x4( real32 a ) { Real32x4 result = { _mm_set1_ps( a ) }; return result; }
+inline Real32x4 real32x4( real32 a, real32 b, real32 c, real32 d ) { Real32x4 result = { _mm_setr_ps( a, b, c, d ) }; return result; }
+inline Real32x4 loadReal32x4( const real32* at ) { Real32x4 result = { _mm_loadu_ps( at ) }; return result; }
+inline void storeReal32x4( real32* at, Real32x4 a ) { _mm_storeu_ps( at, a.v ); }
+
+inline Int32x4 int32x4( int32 a ) { Int32x4 result = { _mm_set1_epi32( a ) }; return result; }
+inline Int32x4 int32x4( int32 a, int32 b, int32 c, int32 d ) { Int32x4 result = { _mm_setr_epi32( a, b, c, d ) }; return result; }
+inline Int32x4 loadInt32x4( const int32* at ) { Int32x4 result = { _mm_loadu_si128( (const __m128i*)at ) }; return result; }
+inline void storeInt32x4( int32* at, Int32x4 a ) { _mm_storeu_si128( (__m128i*)at, a.v ); }
+
+inline real32
+getLane( Real32x4 a, uint32 lane )
+{
+        real32 lanes[4];
+        _mm_storeu_ps( lanes, a.v );
+        return lanes[lane];
+}
+
+inline int32
+getLane( Int32x4 a, uint32 lane )
+{
+        int32 lanes[4];
+        _mm_storeu_si128( (__m128i*)lanes, a.v );
+        return lanes[lane];
+}
+
+inline V2x4
+v2x4( V2 a )
+{
+        V2x4 result;
+        result.x = real32x4( a.x );
+        result.y = real32x4( a.y );
+        return result;
+}
+
+inline V2
+getLane( V2x4 a, uint32 lane )
+{
+        V2 result = { getLane( a.x, lane ), getLane( a.y, lane ) };
+        return result;
+}
+
+inline WorldPosition
+getLane( WorldPositionx4 a, uint32 lane )
+{
+        WorldPosition result;
+        result.tileX = getLane( a.tileX, lane );
+        result.tileY = getLane( a.tileY, lane );
+        result.relative = getLane( a.relative, lane );
+        return result;
+}
+
+// Real32x4
+
+inline Real32x4 operator+( Real32x4 a, Real32x4 b ) { Real32x4 result = { _mm_add_ps( a.v, b.v ) }; return result; }
+inline Real32x4 operator-( Real32x4 a, Real32x4 b ) { Real32x4 result = { _mm_sub_ps( a.v, b.v ) }; return result; }
+inline Real32x4 operator*( Real32x4 a, Real32x4 b ) { Real32x4 result = { _mm_mul_ps( a.v, b.v ) }; return result; }
+inline Real32x4 operator/( Real32x4 a, Real32x4 b ) { Real32x4 result = { _mm_div_ps( a.v, b.v ) }; return result; }
+inline Real32x4 operator*( real32 a, Real32x4 b ) { return real32x4( a ) * b; }
+inline Real32x4 operator/( Real32x4 a, real32 b ) { return a / real32x4( b ); }
+inline Real32x4 operator-( Real32x4 a ) { Real32x4 result = { _mm_sub_ps( _mm_setzero_ps(), a.v ) }; return result; }
+inline Real32x4 &operator+=( Real32x4 &a, Real32x4 b ) { a = a + b; return a; }
+inline Real32x4 &operator-=( Real32x4 &a, Real32x4 b ) { a = a - b; return a; }
+inline Real32x4 &operator*=( Real32x4 &a, real32 b ) { a = b * a; return a; }
+
+inline Mask32x4 operator<( Real32x4 a, Real32x4 b ) { Mask32x4 result = { _mm_cmplt_ps( a.v, b.v ) }; return result; }
+inline Mask32x4 operator<=( Real32x4 a, Real32x4 b ) { Mask32x4 result = { _mm_cmple_ps( a.v, b.v ) }; return result; }
+inline Mask32x4 operator>( Real32x4 a, Real32x4 b ) { Mask32x4 result = { _mm_cmpgt_ps( a.v, b.v ) }; return result; }
+inline Mask32x4 operator>=( Real32x4 a, Real32x4 b ) { Mask32x4 result = { _mm_cmpge_ps( a.v, b.v ) }; return result; }
+inline Mask32x4 operator==( Real32x4 a, Real32x4 b ) { Mask32x4 result = { _mm_cmpeq_ps( a.v, b.v ) }; return result; }
+
+inline Real32x4 minimum( Real32x4 a, Real32x4 b ) { Real32x4 result = { _mm_min_ps( a.v, b.v ) }; return result; }
+inline Real32x4 maximum( Real32x4 a, Real32x4 b ) { Real32x4 result = { _mm_max_ps( a.v, b.v ) }; return result; }
+
+// Int32x4
+
+inline Int32x4 operator+( Int32x4 a, Int32x4 b ) { Int32x4 result = { _mm_add_epi32( a.v, b.v ) }; return result; }
+inline Int32x4 operator-( Int32x4 a, Int32x4 b ) { Int32x4 result = { _mm_sub_epi32( a.v, b.v ) }; return result; }
+inline Int32x4 operator&( Int32x4 a, Int32x4 b ) { Int32x4 result = { _mm_and_si128( a.v, b.v ) }; return result; }
+inline Int32x4 operator>>( Int32x4 a, int32 shift ) { Int32x4 result = { _mm_srai_epi32( a.v, shift ) }; return result; }
+inline Int32x4 operator<<( Int32x4 a, int32 shift ) { Int32x4 result = { _mm_slli_epi32( a.v, shift ) }; return result; }
+inline Int32x4 &operator+=( Int32x4 &a, Int32x4 b ) { a = a + b; return a; }
+
+inline Mask32x4 operator<( Int32x4 a, Int32x4 b ) { Mask32x4 result = { _mm_castsi128_ps( _mm_cmplt_epi32( a.v, b.v ) ) }; return result; }
+inline Mask32x4 operator>( Int32x4 a, Int32x4 b ) { Mask32x4 result = { _mm_castsi128_ps( _mm_cmpgt_epi32( a.v, b.v ) ) }; return result; }
+inline Mask32x4 operator==( Int32x4 a, Int32x4 b ) { Mask32x4 result = { _mm_castsi128_ps( _mm_cmpeq_epi32( a.v, b.v ) ) }; return result; }
+
+inline Real32x4 convertToReal32( Int32x4 a ) { Real32x4 result = { _mm_cvtepi32_ps( a.v ) }; return result; }
+
+// Mask32x4
+
+inline Mask32x4 operator&( Mask32x4 a, Mask32x4 b ) { Mask32x4 result = { _mm_and_ps( a.v, b.v ) }; return result; }
+inline Mask32x4 operator|( Mask32x4 a, Mask32x4 b ) { Mask32x4 result = { _mm_or_ps( a.v, b.v ) }; return result; }
+inline Mask32x4 operator!( Mask32x4 a ) { Mask32x4 result = { _mm_xor_ps( a.v, _mm_castsi128_ps( _mm_set1_epi32( -1 ) ) ) }; return result; }
+
+// One bit per lane, lane 0 in bit 0
+inline uint32 getLaneBits( Mask32x4 a ) { return (uint32)_mm_movemask_ps( a.v ); }
+inline bool32 anyLanes( Mask32x4 a ) { return getLaneBits( a ) != 0; }
+inline bool32 allLanes( Mask32x4 a ) { return getLaneBits( a ) == 0xF; }
+
+// Lanes of a where mask is set, lanes of b elsewhere
+inline Real32x4
+select( Mask32x4 mask, Real32x4 a, Real32x4 b )
+{
+        Real32x4 result = { _mm_or_ps( _mm_and_ps( mask.v, a.v ), _mm_andnot_ps( mask.v, b.v ) ) };
+        return result;
+}
+
+inline Int32x4
+select( Mask32x4 mask, Int32x4 a, Int32x4 b )
+{
+        __m128i m = _mm_castps_si128( mask.v );
+        Int32x4 result = { _mm_or_si128( _mm_and_si128( m, a.v ), _mm_andnot_si128( m, b.v ) ) };
+        return result;
+}
+
+inline V2x4
+select( Mask32x4 mask, V2x4 a, V2x4 b )
+{
+        V2x4 result;
+        result.x = select( mask, a.x, b.x );
+        result.y = select( mask, a.y, b.y );
+        return result;
+}
+
+// Lanes of a where mask is set, zero elsewhere
+inline Int32x4
+maskInt32( Mask32x4 mask, Int32x4 a )
+{
+        Int32x4 result = { _mm_and_si128( _mm_castps_si128( mask.v ), a.v ) };
+        return result;
+}
+
+// V2x4
+
+inline V2x4
+operator+( V2x4 a, V2x4 b )
+{
+        V2x4 result;
+        result.x = a.x + b.x;
+        result.y = a.y + b.y;
+        return result;
+}
+
+inline V2x4 &
+operator+=( V2x4 &a, V2x4 b )
+{
+        a = a + b;
+        return a;
+}
+
+inline V2x4
+operator-( V2x4 a, V2x4 b )
+{
+        V2x4 result;
+        result.x = a.x - b.x;
+        result.y = a.y - b.y;
+        return result;
+}
+
+inline V2x4
+operator*( real32 a, V2x4 b )
+{
+        V2x4 result;
+        result.x = a * b.x;
+        result.y = a * b.y;
+        return result;
+}
+
+inline V2x4
+operator*( Real32x4 a, V2x4 b )
+{
+        V2x4 result;
+        result.x = a * b.x;
+        result.y = a * b.y;
+        return result;
+}
+
+inline V2x4
+operator/( V2x4 a, real32 b )
+{
+        V2x4 result;
+        result.x = a.x / b;
+        result.y = a.y / b;
+        return result;
+}
+
+inline V2x4 &
+operator*=( V2x4 &a, real32 b )
+{
+        a = b * a;
+        return a;
+}
+
+inline Mask32x4
+operator>( V2x4 a, V2x4 b )
+{
+        Mask32x4 result = (a.x > b.x) & (a.y > b.y);
+        return result;
+}
+
+inline Mask32x4
+operator<( V2x4 a, V2x4 b )
+{
+        Mask32x4 result = b > a;
+        return result;
+}
+
+// WorldPositionx4
+
+inline WorldPositionx4
+operator+( WorldPositionx4 a, WorldPositionx4 b )
+{
+        WorldPositionx4 result;
+        result.tileX = a.tileX + b.tileX;
+        result.tileY = a.tileY + b.tileY;
+        result.relative = a.relative + b.relative;
+        return result;
+}
+
+inline WorldPositionx4
+operator-( WorldPositionx4 a, WorldPositionx4 b )
+{
+        WorldPositionx4 result;
+        result.tileX = a.tileX - b.tileX;
+        result.tileY = a.tileY - b.tileY;
+        result.relative = a.relative - b.relative;
+        return result;
+}
+
+inline Mask32x4
+operator>( WorldPositionx4 a, WorldPositionx4 b )
+{
+        Mask32x4 result = (a.tileX > b.tileX) & (a.tileY > b.tileY) & (a.relative > b.relative);
+        return result;
+}
+
+inline Mask32x4
+operator<( WorldPositionx4 a, WorldPositionx4 b )
+{
+        Mask32x4 result = b > a;
+        return result;
+}
+
+// Intrinsics, rounding exactly like their scalar versions
+
+inline Real32x4
+square( Real32x4 a )
+{
+        Real32x4 result = a * a;
+        return result;
+}
+
+inline Int32x4
+truncateReal32ToInt32( Real32x4 a )
+{
+        Int32x4 result = { _mm_cvttps_epi32( a.v ) };
+        return result;
+}
+
+inline Int32x4
+roundReal32ToInt32( Real32x4 a )
+{
+        Int32x4 result = truncateReal32ToInt32( a + real32x4( 0.5f ) );
+        return result;
+}
+
+inline Int32x4
+floorReal32ToInt32( Real32x4 a )
+{
+        // Truncation rounds negative numbers up, step those back down
+        Int32x4 truncated = truncateReal32ToInt32( a );
+        Mask32x4 roundedUp = convertToReal32( truncated ) > a;
+        Int32x4 result = truncated - maskInt32( roundedUp, int32x4( 1 ) );
+        return result;
+}
+
+#endif // SIMD_SSE2
+
+#if SIMD_AVX2
+
+//
+// 8 lanes
+//
+
+struct Real32x8
+{
+        __m256 v;
+};
+
+struct Int32x8
+{
+        __m256i v;
+};
+
+struct Mask32x8
+{
+        __m256 v;
+};
+
+struct V2x8
+{
+        Real32x8 x, y;
+};
+
+struct WorldPositionx8
+{
+        Int32x8 tileX;
+        Int32x8 tileY;
+        V2x8 relative;
+};
+
+inline Real32x8 real32x8( real32 a ) { Real32x8 result = { _mm256_set1_ps( a ) }; return result; }
+inline Real32x8 loadReal32x8( const real32* at ) { Real32x8 result = { _mm256_loadu_ps( at ) }; return result; }
+inline void storeReal32x8( real32* at, Real32x8 a ) { _mm256_storeu_ps( at, a.v ); }
+
+inline Int32x8 int32x8( int32 a ) { Int32x8 result = { _mm256_set1_epi32( a ) }; return result; }
+inline Int32x8 loadInt32x8( const int32* at ) { Int32x8 result = { _mm256_loadu_si256( (const __m256i*)at ) }; return result; }
+inline void storeInt32x8( int32* at, Int32x8 a ) { _mm256_storeu_si256( (__m256i*)at, a.v ); }
+
+inline real32
+getLane( Real32x8 a, uint32 lane )
+{
+        real32 lanes[8];
+        _mm256_storeu_ps( lanes, a.v );
+        return lanes[lane];
+}
+
+inline int32
+getLane( Int32x8 a, uint32 lane )
+{
+        int32 lanes[8];
+        _mm256_storeu_si256( (__m256i*)lanes, a.v );
+        return lanes[lane];
+}
+
+inline V2x8
+v2x8( V2 a )
+{
+        V2x8 result;
+        result.x = real32x8( a.x );
+        result.y = real32x8( a.y );
+        return result;
+}
+
+inline V2
+getLane( V2x8 a, uint32 lane )
+{
+        V2 result = { getLane( a.x, lane ), getLane( a.y, lane ) };
+        return result;
+}
+
+inline WorldPosition
+getLane( WorldPositionx8 a, uint32 lane )
+{
+        WorldPosition result;
+        result.tileX = getLane( a.tileX, lane );
+        result.tileY = getLane( a.tileY, lane );
+        result.relative = getLane( a.relative, lane );
+        return result;
+}
+
+// Real32x8
+
+inline Real32x8 operator+( Real32x8 a, Real32x8 b ) { Real32x8 result = { _mm256_add_ps( a.v, b.v ) }; return result; }
+inline Real32x8 operator-( Real32x8 a, Real32x8 b ) { Real32x8 result = { _mm256_sub_ps( a.v, b.v ) }; return result; }
+inline Real32x8 operator*( Real32x8 a, Real32x8 b ) { Real32x8 result = { _mm256_mul_ps( a.v, b.v ) }; return result; }
+inline Real32x8 operator/( Real32x8 a, Real32x8 b ) { Real32x8 result = { _mm256_div_ps( a.v, b.v ) }; return result; }
+inline Real32x8 operator*( real32 a, Real32x8 b ) { return real32x8( a ) * b; }
+inline Real32x8 operator/( Real32x8 a, real32 b ) { return a / real32x8( b ); }
+inline Real32x8 operator-( Real32x8 a ) { Real32x8 result = { _mm256_sub_ps( _mm256_setzero_ps(), a.v ) }; return result; }
+inline Real32x8 &operator+=( Real32x8 &a, Real32x8 b ) { a = a + b; return a; }
+inline Real32x8 &operator-=( Real32x8 &a, Real32x8 b ) { a = a - b; return a; }
+inline Real32x8 &operator*=( Real32x8 &a, real32 b ) { a = b * a; return a; }
+
+inline Mask32x8 operator<( Real32x8 a, Real32x8 b ) { Mask32x8 result = { _mm256_cmp_ps( a.v, b.v, _CMP_LT_OQ ) }; return result; }
+inline Mask32x8 operator<=( Real32x8 a, Real32x8 b ) { Mask32x8 result = { _mm256_cmp_ps( a.v, b.v, _CMP_LE_OQ ) }; return result; }
+inline Mask32x8 operator>( Real32x8 a, Real32x8 b ) { Mask32x8 result = { _mm256_cmp_ps( a.v, b.v, _CMP_GT_OQ ) }; return result; }
+inline Mask32x8 operator>=( Real32x8 a, Real32x8 b ) { Mask32x8 result = { _mm256_cmp_ps( a.v, b.v, _CMP_GE_OQ ) }; return result; }
+inline Mask32x8 operator==( Real32x8 a, Real32x8 b ) { Mask32x8 result = { _mm256_cmp_ps( a.v, b.v, _CMP_EQ_OQ ) }; return result; }
+
+inline Real32x8 minimum( Real32x8 a, Real32x8 b ) { Real32x8 result = { _mm256_min_ps( a.v, b.v ) }; return result; }
+inline Real32x8 maximum( Real32x8 a, Real32x8 b ) { Real32x8 result = { _mm256_max_ps( a.v, b.v ) }; return result; }
+
+// Int32x8
+
+inline Int32x8 operator+( Int32x8 a, Int32x8 b ) { Int32x8 result = { _mm256_add_epi32( a.v, b.v ) }; return result; }
+inline Int32x8 operator-( Int32x8 a, Int32x8 b ) { Int32x8 result = { _mm256_sub_epi32( a.v, b.v ) }; return result; }
+inline Int32x8 operator&( Int32x8 a, Int32x8 b ) { Int32x8 result = { _mm256_and_si256( a.v, b.v ) }; return result; }
+inline Int32x8 operator>>( Int32x8 a, int32 shift ) { Int32x8 result = { _mm256_srai_epi32( a.v, shift ) }; return result; }
+inline Int32x8 operator<<( Int32x8 a, int32 shift ) { Int32x8 result = { _mm256_slli_epi32( a.v, shift ) }; return result; }
+inline Int32x8 &operator+=( Int32x8 &a, Int32x8 b ) { a = a + b; return a; }
+
+inline Mask32x8 operator<( Int32x8 a, Int32x8 b ) { Mask32x8 result = { _mm256_castsi256_ps( _mm256_cmpgt_epi32( b.v, a.v ) ) }; return result; }
+inline Mask32x8 operator>( Int32x8 a, Int32x8 b ) { Mask32x8 result = { _mm256_castsi256_ps( _mm256_cmpgt_epi32( a.v, b.v ) ) }; return result; }
+inline Mask32x8 operator==( Int32x8 a, Int32x8 b ) { Mask32x8 result = { _mm256_castsi256_ps( _mm256_cmpeq_epi32( a.v, b.v ) ) }; return result; }
+
+inline Real32x8 convertToReal32( Int32x8 a ) { Real32x8 result = { _mm256_cvtepi32_ps( a.v ) }; return result; }
+
+// Mask32x8
+
+inline Mask32x8 operator&( Mask32x8 a, Mask32x8 b ) { Mask32x8 result = { _mm256_and_ps( a.v, b.v ) }; return result; }
+inline Mask32x8 operator|( Mask32x8 a, Mask32x8 b ) { Mask32x8 result = { _mm256_or_ps( a.v, b.v ) }; return result; }
+inline Mask32x8 operator!( Mask32x8 a ) { Mask32x8 result = { _mm256_xor_ps( a.v, _mm256_castsi256_ps( _mm256_set1_epi32( -1 ) ) ) }; return result; }
+
+inline uint32 getLaneBits( Mask32x8 a ) { return (uint32)_mm256_movemask_ps( a.v ); }
+inline bool32 anyLanes( Mask32x8 a ) { return getLaneBits( a ) != 0; }
+inline bool32 allLanes( Mask32x8 a ) { return getLaneBits( a ) == 0xFF; }
+
+inline Real32x8
+select( Mask32x8 mask, Real32x8 a, Real32x8 b )
+{
+        Real32x8 result = { _mm256_blendv_ps( b.v, a.v, mask.v ) };
+        return result;
+}
+
+inline Int32x8
+select( Mask32x8 mask, Int32x8 a, Int32x8 b )
+{
+        Int32x8 result = { _mm256_blendv_epi8( b.v, a.v, _mm256_castps_si256( mask.v ) ) };
+        return result;
+}
+
+inline V2x8
+select( Mask32x8 mask, V2x8 a, V2x8 b )
+{
+        V2x8 result;
+        result.x = select( mask, a.x, b.x );
+        result.y = select( mask, a.y, b.y );
+        return result;
+}
+
+inline Int32x8
+maskInt32( Mask32x8 mask, Int32x8 a )
+{
+        Int32x8 result = { _mm256_and_si256( _mm256_castps_si256( mask.v ), a.v ) };
+        return result;
+}
+
+// V2x8
+
+inline V2x8
+operator+( V2x8 a, V2x8 b )
+{
+        V2x8 result;
+        result.x = a.x + b.x;
+        result.y = a.y + b.y;
+        return result;
+}
+
+inline V2x8 &
+operator+=( V2x8 &a, V2x8 b )
+{
+        a = a + b;
+        return a;
+}
+
+inline V2x8
+operator-( V2x8 a, V2x8 b )
+{
+        V2x8 result;
+        result.x = a.x - b.x;
+        result.y = a.y - b.y;
+        return result;
+}
+
+inline V2x8
+operator*( real32 a, V2x8 b )
+{
+        V2x8 result;
+        result.x = a * b.x;
+        result.y = a * b.y;
+        return result;
+}
+
+inline V2x8
+operator*( Real32x8 a, V2x8 b )
+{
+        V2x8 result;
+        result.x = a * b.x;
+        result.y = a * b.y;
+        return result;
+}
+
+inline V2x8
+operator/( V2x8 a, real32 b )
+{
+        V2x8 result;
+        result.x = a.x / b;
+        result.y = a.y / b;
+        return result;
+}
+
+inline V2x8 &
+operator*=( V2x8 &a, real32 b )
+{
+        a = b * a;
+        return a;
+}
+
+inline Mask32x8
+operator>( V2x8 a, V2x8 b )
+{
+        Mask32x8 result = (a.x > b.x) & (a.y > b.y);
+        return result;
+}
+
+inline Mask32x8
+operator<( V2x8 a, V2x8 b )
+{
+        Mask32x8 result = b > a;
+        return result;
+}
+
+// WorldPositionx8
+
+inline WorldPositionx8
+operator+( WorldPositionx8 a, WorldPositionx8 b )
+{
+        WorldPositionx8 result;
+        result.tileX = a.tileX + b.tileX;
+        result.tileY = a.tileY + b.tileY;
+        result.relative = a.relative + b.relative;
+        return result;
+}
+
+inline WorldPositionx8
+operator-( WorldPositionx8 a, WorldPositionx8 b )
+{
+        WorldPositionx8 result;
+        result.tileX = a.tileX - b.tileX;
+        result.tileY = a.tileY - b.tileY;
+        result.relative = a.relative - b.relative;
+        return result;
+}
+
+inline Mask32x8
+operator>( WorldPositionx8 a, WorldPositionx8 b )
+{
+        Mask32x8 result = (a.tileX > b.tileX) & (a.tileY > b.tileY) & (a.relative > b.relative);
+        return result;
+}
+
+inline Mask32x8
+operator<( WorldPositionx8 a, WorldPositionx8 b )
+{
+        Mask32x8 result = b > a;
+        return result;
+}
+
+// Intrinsics
+
+inline Real32x8
+square( Real32x8 a )
+{
+        Real32x8 result = a * a;
+        return result;
+}
+
+inline Int32x8
+truncateReal32ToInt32( Real32x8 a )
+{
+        Int32x8 result = { _mm256_cvttps_epi32( a.v ) };
+        return result;
+}
+
+inline Int32x8
+roundReal32ToInt32( Real32x8 a )
+{
+        Int32x8 result = truncateReal32ToInt32( a + real32x8( 0.5f ) );
+        return result;
+}
+
+inline Int32x8
+floorReal32ToInt32( Real32x8 a )
+{
+        Int32x8 result = { _mm256_cvttps_epi32( _mm256_floor_ps( a.v ) ) };
+        return result;
+}
+
+#endif // SIMD_AVX2
+
+//
+// Lanes
+//
+
+#if SIMD_AVX2
+#define LANE_WIDTH 8
+typedef Real32x8 LaneR32;
+typedef Int32x8 LaneI32;
+typedef Mask32x8 LaneMask;
+typedef V2x8 LaneV2;
+typedef WorldPositionx8 LaneWorldPosition;
+inline LaneR32 laneR32( real32 a ) { return real32x8( a ); }
+inline LaneI32 laneI32( int32 a ) { return int32x8( a ); }
+inline LaneR32 loadLaneR32( const real32* at ) { return loadReal32x8( at ); }
+inline LaneI32 loadLaneI32( const int32* at ) { return loadInt32x8( at ); }
+inline void storeLaneR32( real32* at, LaneR32 a ) { storeReal32x8( at, a ); }
+inline void storeLaneI32( int32* at, LaneI32 a ) { storeInt32x8( at, a ); }
+#elif SIMD_SSE2
+#define LANE_WIDTH 4
+typedef Real32x4 LaneR32;
+typedef Int32x4 LaneI32;
+typedef Mask32x4 LaneMask;
+typedef V2x4 LaneV2;
+typedef WorldPositionx4 LaneWorldPosition;
+inline LaneR32 laneR32( real32 a ) { return real32x4( a ); }
+inline LaneI32 laneI32( int32 a ) { return int32x4( a ); }
+inline LaneR32 loadLaneR32( const real32* at ) { return loadReal32x4( at ); }
+inline LaneI32 loadLaneI32( const int32* at ) { return loadInt32x4( at ); }
+inline void storeLaneR32( real32* at, LaneR32 a ) { storeReal32x4( at, a ); }
+inline void storeLaneI32( int32* at, LaneI32 a ) { storeInt32x4( at, a ); }
+#else
+#define LANE_WIDTH 1
+typedef real32 LaneR32;
+typedef int32 LaneI32;
+typedef bool32 LaneMask;
+typedef V2 LaneV2;
+struct LaneWorldPosition
+{
+        int32 tileX;
+        int32 tileY;
+        V2 relative;
+};
+inline LaneR32 laneR32( real32 a ) { return a; }
+inline LaneI32 laneI32( int32 a ) { return a; }
+inline LaneR32 loadLaneR32( const real32* at ) { return *at; }
+inline LaneI32 loadLaneI32( const int32* at ) { return *at; }
+inline void storeLaneR32( real32* at, LaneR32 a ) { *at = a; }
+inline void storeLaneI32( int32* at, LaneI32 a ) { *at = a; }
+inline real32 getLane( real32 a, uint32 /*lane*/ ) { return a; }
+inline int32 getLane( int32 a, uint32 /*lane*/ ) { return a; }
+inline V2 getLane( V2 a, uint32 /*lane*/ ) { return a; }
+inline WorldPosition getLane( LaneWorldPosition a, uint32 /*lane*/ ) { WorldPosition result = { a.tileX, a.tileY, a.relative }; return result; }
+inline uint32 getLaneBits( bool32 mask ) { return mask ? 1 : 0; }
+inline real32 minimum( real32 a, real32 b ) { return a < b ? a : b; }
+inline real32 maximum( real32 a, real32 b ) { return a > b ? a : b; }
+inline int32 maskInt32( bool32 mask, int32 a ) { return mask ? a : 0; }
+#endif
@@ -0,0 +1,987 @@
+// Snapshots
+//
+// A snapshot is a binary image of the GameState and the tile chunks of
+// its world. A full snapshot contains every chunk. A delta snapshot is
+// encoded against a full (base) snapshot and contains only the chunks
+// whose contents differ from the base and the chunks created since it,
+// so loading a delta means loading its base first.
+//
+// Layout (host byte order):
+//   header   magic, version, flags, id, baseId
+//   world    tile sizes, chunk shift
+//   player   position, velocity, size
+//   camera   position, size
+//   chunks   record count, then per record:
+//            chunk x, chunk y, encoding, payload size, payload
+//
+// Chunks are identified by their coordinates, so a snapshot can be
+// loaded into a world that doesn't have all of its chunks yet.
+#include <time.h>
+
+//
+// LZ compression
+//
+// Byte oriented LZ77 using the LZ4 block format: each sequence is a
+// token (literal length, match length), the literals, and a 16 bit
+// back-reference offset. Tile data is highly repetitive so this is
+// enough to shrink chunks considerably at memcpy-like speeds.
+//
+
+#define LZ_HASH_BITS 12
+#define LZ_MIN_MATCH 4
+#define LZ_LAST_LITERALS 5
+#define LZ_MATCH_LIMIT 12
+#define LZ_MAX_OFFSET 65535
+
+inline uint32
+lzCompressBound( uint32 size )
+{
+        uint32 result = size + size / 255 + 16;
+        return result;
+}
+
+inline uint32
+lzRead32( uint8* at )
+{
+        uint32 result;
+        memcpy( &result, at, sizeof(result) );
+        return result;
+}
+
+internal uint8*
+lzWriteLength( uint8* op, uint32 length )
+{
+        while ( length >= 255 )
+        {
+                *op++ = 255;
+                length -= 255;
+        }
+        *op++ = (uint8)length;
+        return op;
+}
+
+// Returns the compressed size, or 0 if the output would not fit
+internal uint32
+lzCompress( uint8* src, uint32 srcSize, uint8* dst, uint32 dstCapacity )
+{
+        uint32 hashTable[1 << LZ_HASH_BITS];
+        memset( hashTable, 0, sizeof(hashTable) );
+
+        uint8* ip = src;
+        uint8* anchor = src;
+        uint8* end = src + srcSize;
+        uint8* op = dst;
+        uint8* opEnd = dst + dstCapacity;
+
+        if ( srcSize > LZ_MATCH_LIMIT )
+        {
+                uint8* matchStartLimit = end - LZ_MATCH_LIMIT;
+                uint8* matchEndLimit = end - LZ_LAST_LITERALS;
+
+                while ( ip < matchStartLimit )
+                {
+                        uint32 sequence = lzRead32( ip );
+                        uint32 hash = (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+                        uint8* ref = src + hashTable[hash];
+                        hashTable[hash] = (uint32)(ip - src);
+
+                        if ( ref >= ip || ip - ref > LZ_MAX_OFFSET ||
+                             lzRead32( ref ) != sequence )
+                        {
+                                ++ip;
+                                continue;
+                        }
+
+                        uint8* matchEnd = ip + LZ_MIN_MATCH;
+                        ref += LZ_MIN_MATCH;
+                        while ( matchEnd < matchEndLimit && *matchEnd == *ref )
+                        {
+                                ++matchEnd;
+                                ++ref;
+                        }
+
+                        uint32 literalLength = (uint32)(ip - anchor);
+                        uint32 matchLength = (uint32)(matchEnd - ip) - LZ_MIN_MATCH;
+                        uint32 offset = (uint32)(matchEnd - ref);
+
+                        // token + literal length + literals + offset + match length
+                        uint32 worstCase = 1 + literalLength / 255 + 1 + literalLength +
+                                2 + matchLength / 255 + 1;
+                        if ( (uint32)(opEnd - op) < worstCase )
+                        {
+                                return 0;
+                        }
+
+                        uint8* token = op++;
+                        *token = 0;
+                        if ( literalLength >= 15 )
+                        {
+                                *token = 15 << 4;
+                                op = lzWriteLength( op, literalLength - 15 );
+                        }
+                        else
+                        {
+                                *token = (uint8)(literalLength << 4);
+                        }
+                        memcpy( op, anchor, literalLength );
+                        op += literalLength;
+
+                        *op++ = (uint8)(offset & 0xFF);
+                        *op++ = (uint8)(offset >> 8);
+
+                        if ( matchLength >= 15 )
+                        {
+                                *token |= 15;
+                                op = lzWriteLength( op, matchLength - 15 );
+                        }
+                        else
+                        {
+                                *token |= (uint8)matchLength;
+                        }
+
+                        ip = matchEnd;
+                        anchor = ip;
+                }
+        }
+
+        // The last sequence is literals only
+        uint32 literalLength = (uint32)(end - anchor);
+        uint32 worstCase = 1 + literalLength / 255 + 1 + literalLength;
+        if ( (uint32)(opEnd - op) < worstCase )
+        {
+                return 0;
+        }
+        if ( literalLength >= 15 )
+        {
+                *op++ = 15 << 4;
+                op = lzWriteLength( op, literalLength - 15 );
+        }
+        else
+        {
+                *op++ = (uint8)(literalLength << 4);
+        }
+        memcpy( op, anchor, literalLength );
+        op += literalLength;
+
+        uint32 result = (uint32)(op - dst);
+        return result;
+}
+
+// Returns true only if exactly dstSize bytes were decoded
+internal bool32
+lzDecompress( uint8* src, uint32 srcSize, uint8* dst, uint32 dstSize )
+{
+        uint8* ip = src;
+        uint8* ipEnd = src + srcSize;
+        uint8* op = dst;
+        uint8* opEnd = dst + dstSize;
+
+        while ( ip < ipEnd )
+        {
+                uint32 token = *ip++;
+
+                uint32 literalLength = token >> 4;
+                if ( literalLength == 15 )
+                {
+                        uint32 extra;
+                        do
+                        {
+                                if ( ip >= ipEnd )
+                                {
+                                        return false;
+                                }
+                                extra = *ip++;
+                                literalLength += extra;
+                        } while ( extra == 255 );
+                }
+                if ( (uint32)(ipEnd - ip) < literalLength ||
+                     (uint32)(opEnd - op) < literalLength )
+                {
+                        return false;
+                }
+                memcpy( op, ip, literalLength );
+                ip += literalLength;
+                op += literalLength;
+
+                if ( ip == ipEnd )
+                {
+                        break;
+                }
+
+                if ( ipEnd - ip < 2 )
+                {
+                        return false;
+                }
+                uint32 offset = ip[0] | (ip[1] << 8);
+                ip += 2;
+                if ( offset == 0 || offset > (uint32)(op - dst) )
+                {
+                        return false;
+                }
+
+                uint32 matchLength = token & 15;
+                if ( matchLength == 15 )
+                {
+                        uint32 extra;
+                        do
+                        {
+                                if ( ip >= ipEnd )
+                                {
+                                        return false;
+                                }
+                                extra = *ip++;
+                                matchLength += extra;
+                        } while ( extra == 255 );
+                }
+                matchLength += LZ_MIN_MATCH;
+                if ( (uint32)(opEnd - op) < matchLength )
+                {
+                        return false;
+                }
+
+                // Matches may overlap their own output
+                uint8* match = op - offset;
+                for ( uint32 i = 0; i < matchLength; ++i )
+                {
+                        *op++ = *match++;
+                }
+        }
+
+        bool32 result = (op == opEnd);
+        return result;
+}
+
+//
+// Serialization
+//
+
+internal void
+writeBytes( SnapshotBuffer* buffer, void* data, uint32 size )
+{
+        if ( buffer->size + size > buffer->capacity )
+        {
+                uint32 capacity = buffer->capacity ? buffer->capacity : 4096;
+                while ( capacity < buffer->size + size )
+                {
+                        capacity *= 2;
+                }
+                buffer->data = (uint8*)realloc( buffer->data, capacity );
+                buffer->capacity = capacity;
+        }
+        memcpy( buffer->data + buffer->size, data, size );
+        buffer->size += size;
+}
+
+inline void writeUint8( SnapshotBuffer* buffer, uint8 value ) { writeBytes( buffer, &value, sizeof(value) ); }
+inline void writeUint32( SnapshotBuffer* buffer, uint32 value ) { writeBytes( buffer, &value, sizeof(value) ); }
+inline void writeInt32( SnapshotBuffer* buffer, int32 value ) { writeBytes( buffer, &value, sizeof(value) ); }
+inline void writeUint64( SnapshotBuffer* buffer, uint64 value ) { writeBytes( buffer, &value, sizeof(value) ); }
+inline void writeInt64( SnapshotBuffer* buffer, int64 value ) { writeBytes( buffer, &value, sizeof(value) ); }
+inline void writeReal32( SnapshotBuffer* buffer, real32 value ) { writeBytes( buffer, &value, sizeof(value) ); }
+
+inline void
+writeV2( SnapshotBuffer* buffer, V2 value )
+{
+        writeReal32( buffer, value.x );
+        writeReal32( buffer, value.y );
+}
+
+inline void
+writeWorldPosition( SnapshotBuffer* buffer, WorldPosition value )
+{
+        writeInt64( buffer, value.tileX );
+        writeInt64( buffer, value.tileY );
+        writeV2( buffer, value.relative );
+}
+
+internal void
+readBytes( SnapshotReader* reader, void* data, uint32 size )
+{
+        if ( !reader->valid || (uint32)(reader->end - reader->at) < size )
+        {
+                reader->valid = false;
+                memset( data, 0, size );
+                return;
+        }
+        memcpy( data, reader->at, size );
+        reader->at += size;
+}
+
+inline uint8 readUint8( SnapshotReader* reader ) { uint8 value; readBytes( reader, &value, sizeof(value) ); return value; }
+inline uint32 readUint32( SnapshotReader* reader ) { uint32 value; readBytes( reader, &value, sizeof(value) ); return value; }
+inline int32 readInt32( SnapshotReader* reader ) { int32 value; readBytes( reader, &value, sizeof(value) ); return value; }
+inline uint64 readUint64( SnapshotReader* reader ) { uint64 value; readBytes( reader, &value, sizeof(value) ); return value; }
+inline int64 readInt64( SnapshotReader* reader ) { int64 value; readBytes( reader, &value, sizeof(value) ); return value; }
+inline real32 readReal32( SnapshotReader* reader ) { real32 value; readBytes( reader, &value, sizeof(value) ); return value; }
+
+inline V2
+readV2( SnapshotReader* reader )
+{
+        V2 result;
+        result.x = readReal32( reader );
+        result.y = readReal32( reader );
+        return result;
+}
+
+inline WorldPosition
+readWorldPosition( SnapshotReader* reader )
+{
+        WorldPosition result;
+        result.tileX = readInt64( reader );
+        result.tileY = readInt64( reader );
+        result.relative = readV2( reader );
+        return result;
+}
+
+inline uint32
+getTileChunkCount( TileMap* tileMap )
+{
+        uint32 result = tileMap->tileChunkCount;
+        return result;
+}
+
+inline uint32
+getTileChunkTileCount( TileMap* tileMap )
+{
+        uint32 result = tileMap->chunkDim * tileMap->chunkDim;
+        return result;
+}
+
+internal uint64
+hashTiles( uint32* tiles, uint32 count )
+{
+        uint64 hash = 14695981039346656037ULL;
+        for ( uint32 i = 0; i < count; ++i )
+        {
+                hash ^= tiles[i];
+                hash *= 1099511628211ULL;
+        }
+        return hash;
+}
+
+inline uint64
+getPerformanceCounter()
+{
+        uint64 result = SDL_GetPerformanceCounter();
+        return result;
+}
+
+inline real64
+getSecondsElapsed( uint64 start, uint64 end )
+{
+        real64 result = (real64)(end - start) / (real64)SDL_GetPerformanceFrequency();
+        return result;
+}
+
+internal void
+freeSnapshotBase( SnapshotBase* base )
+{
+        if ( base->tileChunks )
+        {
+                for ( uint32 chunkIndex = 0; chunkIndex < base->chunkCount; ++chunkIndex )
+                {
+                        releaseTileChunk( base->tileChunks[chunkIndex] );
+                }
+        }
+        free( base->chunkHashes );
+        free( base->tileChunks );
+        base->id = 0;
+        base->chunkCount = 0;
+        base->chunkHashes = 0;
+        base->tileChunks = 0;
+}
+
+// Encode gameState into buffer. If base is not null and the world still
+// has all of its chunks, only chunks that changed or were created since
+// the base are written. If updateBase is not null it receives the chunk
+// hashes of this snapshot so that it can serve as the base for later
+// deltas; its chunk references are up to the caller.
+internal void
+encodeSnapshot( SnapshotBuffer* buffer,
+                GameState* gameState,
+                uint64 id,
+                SnapshotBase* base,
+                SnapshotBase* updateBase,
+                bool32 compress,
+                uint8* scratch,
+                SnapshotStats* stats )
+{
+        World* world = gameState->world;
+        TileMap* tileMap = world->tileMap;
+        uint32 chunkCount = getTileChunkCount( tileMap );
+        uint32 chunkTileCount = getTileChunkTileCount( tileMap );
+        uint32 chunkBytes = chunkTileCount * sizeof(uint32);
+
+        bool32 isDelta = (base && base->chunkHashes && base->chunkCount <= chunkCount);
+
+        if ( updateBase )
+        {
+                freeSnapshotBase( updateBase );
+                updateBase->id = id;
+                updateBase->chunkCount = chunkCount;
+                updateBase->chunkHashes = (uint64*)malloc( chunkCount * sizeof(uint64) );
+        }
+
+        buffer->size = 0;
+        writeUint32( buffer, SNAPSHOT_MAGIC );
+        writeUint32( buffer, SNAPSHOT_VERSION );
+        writeUint32( buffer, isDelta ? SnapshotFlag_Delta : 0 );
+        writeUint64( buffer, id );
+        writeUint64( buffer, isDelta ? base->id : 0 );
+
+        writeReal32( buffer, world->tileSideInMeters );
+        writeReal32( buffer, world->tileSideInPixels );
+        writeUint32( buffer, tileMap->chunkShift );
+
+        writeWorldPosition( buffer, gameState->player.position );
+        writeV2( buffer, gameState->player.velocity );
+        writeV2( buffer, gameState->player.size );
+        writeWorldPosition( buffer, gameState->camera.position );
+        writeV2( buffer, gameState->camera.size );
+
+        // Patched once the number of written chunks is known
+        uint32 recordCountOffset = buffer->size;
+        writeUint32( buffer, 0 );
+
+        uint32 chunksWritten = 0;
+        for ( uint32 chunkIndex = 0; chunkIndex < chunkCount; ++chunkIndex )
+        {
+                TileChunk* tileChunk = &tileMap->tileChunks[chunkIndex];
+                uint32* tiles = tileChunk->tiles;
+                if ( isDelta && chunkIndex < base->chunkCount )
+                {
+                        // Only chunks the world has written to since the
+                        // base need hashing
+                        if ( base->tileChunks && base->tileChunks[chunkIndex].tiles == tiles )
+                        {
+                                continue;
+                        }
+                        if ( base->chunkHashes[chunkIndex] == hashTiles( tiles, chunkTileCount ) )
+                        {
+                                continue;
+                        }
+                }
+                if ( updateBase )
+                {
+                        updateBase->chunkHashes[chunkIndex] = hashTiles( tiles, chunkTileCount );
+                }
+
+                uint32 compressedSize = 0;
+                if ( compress )
+                {
+                        compressedSize = lzCompress( (uint8*)tiles, chunkBytes,
+                                                     scratch, lzCompressBound( chunkBytes ) );
+                }
+
+                writeInt64( buffer, tileChunk->chunkX );
+                writeInt64( buffer, tileChunk->chunkY );
+                if ( compressedSize && compressedSize < chunkBytes )
+                {
+                        writeUint8( buffer, ChunkEncoding_LZ );
+                        writeUint32( buffer, compressedSize );
+                        writeBytes( buffer, scratch, compressedSize );
+                }
+                else
+                {
+                        writeUint8( buffer, ChunkEncoding_Raw );
+                        writeUint32( buffer, chunkBytes );
+                        writeBytes( buffer, tiles, chunkBytes );
+                }
+                ++chunksWritten;
+        }
+        memcpy( buffer->data + recordCountOffset, &chunksWritten, sizeof(chunksWritten) );
+
+        if ( stats )
+        {
+                stats->chunkCount = chunkCount;
+                stats->chunksWritten = chunksWritten;
+                stats->rawBytes = chunkCount * chunkBytes;
+                stats->encodedBytes = buffer->size;
+        }
+}
+
+// Decode a snapshot into gameState, whose world must already have the
+// same chunk size. The chunks are decoded into a staging map, and only
+// once the whole snapshot has decoded does it replace the world's map,
+// so a corrupt snapshot leaves the world as it was. A full snapshot
+// drops the chunks it doesn't list; a delta starts from the chunks of
+// the world and is only accepted if expectedBaseId matches the base it
+// was encoded against, i.e. the base has already been decoded.
+internal bool32
+decodeSnapshot( uint8* data,
+                uint32 size,
+                GameState* gameState,
+                uint64 expectedBaseId,
+                uint64* id,
+                SnapshotStats* stats )
+{
+        World* world = gameState->world;
+        TileMap* tileMap = world->tileMap;
+        uint32 chunkBytes = getTileChunkTileCount( tileMap ) * sizeof(uint32);
+
+        SnapshotReader reader = { data, data + size, true };
+
+        uint32 magic = readUint32( &reader );
+        uint32 version = readUint32( &reader );
+        uint32 flags = readUint32( &reader );
+        uint64 snapshotId = readUint64( &reader );
+        uint64 baseId = readUint64( &reader );
+        if ( !reader.valid || magic != SNAPSHOT_MAGIC || version != SNAPSHOT_VERSION )
+        {
+                printf( "Snapshot has an invalid header.\n" );
+                return false;
+        }
+        if ( (flags & SnapshotFlag_Delta) && baseId != expectedBaseId )
+        {
+                printf( "Snapshot delta does not match the loaded base.\n" );
+                return false;
+        }
+
+        real32 tileSideInMeters = readReal32( &reader );
+        real32 tileSideInPixels = readReal32( &reader );
+        uint32 chunkShift = readUint32( &reader );
+        if ( chunkShift != tileMap->chunkShift )
+        {
+                printf( "Snapshot world layout does not match.\n" );
+                return false;
+        }
+
+        Player player;
+        player.position = readWorldPosition( &reader );
+        player.velocity = readV2( &reader );
+        player.size = readV2( &reader );
+
+        Camera camera;
+        camera.position = readWorldPosition( &reader );
+        camera.size = readV2( &reader );
+
+        // Every record takes at least its header
+        uint32 recordHeaderSize = 2 * sizeof(int64) + sizeof(uint8) + sizeof(uint32);
+        uint32 recordCount = readUint32( &reader );
+        if ( !reader.valid || recordCount > (uint32)(reader.end - reader.at) / recordHeaderSize )
+        {
+                printf( "Snapshot is truncated.\n" );
+                return false;
+        }
+
+        // A delta shares the chunks it doesn't list with the world, the
+        // chunks it does list are copied before they are written
+        World stagedWorld = *world;
+        TileMap staged;
+        if ( flags & SnapshotFlag_Delta )
+        {
+                copyTileMap( &staged, tileMap );
+        }
+        else
+        {
+                initializeTileMap( &stagedWorld, &staged, chunkShift );
+        }
+
+        for ( uint32 record = 0; record < recordCount; ++record )
+        {
+                int64 chunkX = readInt64( &reader );
+                int64 chunkY = readInt64( &reader );
+                uint8 encoding = readUint8( &reader );
+                uint32 payloadSize = readUint32( &reader );
+                if ( !reader.valid || (uint32)(reader.end - reader.at) < payloadSize )
+                {
+                        printf( "Snapshot chunk record is invalid.\n" );
+                        freeTileMap( &staged );
+                        return false;
+                }
+
+                TileChunk* tileChunk = getOrCreateTileChunk( &staged, chunkX, chunkY );
+                makeTileChunkWritable( &staged, tileChunk );
+                uint8* tiles = (uint8*)tileChunk->tiles;
+                bool32 decoded = false;
+                if ( encoding == ChunkEncoding_Raw && payloadSize == chunkBytes )
+                {
+                        memcpy( tiles, reader.at, chunkBytes );
+                        decoded = true;
+                }
+                else if ( encoding == ChunkEncoding_LZ )
+                {
+                        decoded = lzDecompress( reader.at, payloadSize, tiles, chunkBytes );
+                }
+                if ( !decoded )
+                {
+                        printf( "Snapshot chunk (%lld, %lld) could not be decoded.\n",
+                                (long long)chunkX, (long long)chunkY );
+                        freeTileMap( &staged );
+                        return false;
+                }
+                reader.at += payloadSize;
+        }
+
+        // Chunks shared with a save in progress or the rewind history
+        // stay alive until those let go of them
+        staged.dirtyChunks = tileMap->dirtyChunks;
+        freeTileMap( tileMap );
+        *tileMap = staged;
+
+        world->tileSideInMeters = tileSideInMeters;
+        world->tileSideInPixels = tileSideInPixels;
+        world->metersToPixels = tileSideInPixels / tileSideInMeters;
+        gameState->player = player;
+        gameState->camera = camera;
+
+        if ( id )
+        {
+                *id = snapshotId;
+        }
+        if ( stats )
+        {
+                uint32 chunkCount = getTileChunkCount( tileMap );
+                stats->chunkCount = chunkCount;
+                stats->chunksWritten = recordCount;
+                stats->rawBytes = chunkCount * chunkBytes;
+                stats->encodedBytes = size;
+        }
+        return true;
+}
+
+//
+// Files
+//
+
+internal bool32
+writeFile( const char* path, void* data, uint32 size )
+{
+        FILE* file = fopen( path, "wb" );
+        if ( file == NULL )
+        {
+                printf( "Unable to open %s for writing.\n", path );
+                return false;
+        }
+        bool32 result = (fwrite( data, 1, size, file ) == size);
+        fclose( file );
+        return result;
+}
+
+// Returns a malloc'd buffer, or null if the file could not be read
+internal uint8*
+readFile( const char* path, uint32* size )
+{
+        FILE* file = fopen( path, "rb" );
+        if ( file == NULL )
+        {
+                return 0;
+        }
+        fseek( file, 0, SEEK_END );
+        long fileSize = ftell( file );
+        fseek( file, 0, SEEK_SET );
+
+        uint8* data = (uint8*)malloc( fileSize > 0 ? fileSize : 1 );
+        if ( fileSize < 0 || fread( data, 1, fileSize, file ) != (size_t)fileSize )
+        {
+                free( data );
+                data = 0;
+        }
+        fclose( file );
+
+        *size = (uint32)fileSize;
+        return data;
+}
+
+inline real64
+getMegabytesPerSecond( uint32 bytes, real64 seconds )
+{
+        real64 result = seconds > 0.0 ? (bytes / (1024.0 * 1024.0)) / seconds : 0.0;
+        return result;
+}
+
+//
+// Background saving
+//
+
+internal int
+snapshotThreadProc( void* data )
+{
+        SnapshotWriter* writer = (SnapshotWriter*)data;
+        SnapshotJob* job = &writer->job;
+
+        uint64 start = getPerformanceCounter();
+
+        SnapshotStats stats;
+        uint64 id = writer->nextId++;
+        if ( job->delta )
+        {
+                encodeSnapshot( &writer->buffer, &job->gameState, id,
+                                &writer->base, 0, job->compress, writer->scratch, &stats );
+        }
+        else
+        {
+                encodeSnapshot( &writer->buffer, &job->gameState, id,
+                                0, &writer->base, job->compress, writer->scratch, &stats );
+                job->isNewBase = true;
+        }
+        bool32 written = writeFile( job->path, writer->buffer.data, writer->buffer.size );
+
+        stats.seconds = getSecondsElapsed( start, getPerformanceCounter() );
+        if ( written )
+        {
+                printf( "Saved %s: %u/%u chunks, %u bytes from %u, %.3f ms (%.1f MB/s)\n",
+                        job->path, stats.chunksWritten, stats.chunkCount,
+                        stats.encodedBytes, stats.rawBytes, stats.seconds * 1000.0,
+                        getMegabytesPerSecond( stats.rawBytes, stats.seconds ) );
+        }
+
+        SDL_AtomicSet( &writer->busy, 0 );
+        return 0;
+}
+
+// Waits for an in-flight save to finish and hands its chunks back, or
+// to the base if it was a full snapshot. Reference counts are only
+// touched on the main thread.
+internal void
+finishSnapshotWriter( SnapshotWriter* writer )
+{
+        if ( writer->thread )
+        {
+                SDL_WaitThread( writer->thread, NULL );
+                writer->thread = 0;
+        }
+
+        SnapshotJob* job = &writer->job;
+        if ( job->isNewBase )
+        {
+                SnapshotBase* base = &writer->base;
+                assert( base->chunkCount == job->chunksRetained && !base->tileChunks );
+                base->tileChunks = (TileChunk*)malloc( job->chunksRetained * sizeof(TileChunk) );
+                memcpy( base->tileChunks, job->tileChunks, job->chunksRetained * sizeof(TileChunk) );
+                job->isNewBase = false;
+        }
+        else
+        {
+                for ( uint32 chunkIndex = 0; chunkIndex < job->chunksRetained; ++chunkIndex )
+                {
+                        releaseTileChunk( job->tileChunks[chunkIndex] );
+                }
+        }
+        job->chunksRetained = 0;
+}
+
+// Called every frame so that a finished save stops holding on to chunks
+internal void
+collectSnapshotWriter( SnapshotWriter* writer )
+{
+        if ( writer->thread && !SDL_AtomicGet( &writer->busy ) )
+        {
+                finishSnapshotWriter( writer );
+        }
+}
+
+// Forget the base so that the next save is a full snapshot
+internal void
+resetSnapshotWriter( SnapshotWriter* writer )
+{
+        finishSnapshotWriter( writer );
+        freeSnapshotBase( &writer->base );
+}
+
+// Copy gameState and start encoding it on a background thread. The
+// first save (and the first after a reset) is written in full to
+// basePath, later saves are written as deltas to deltaPath.
+// Returns false if a previous save is still being written.
+internal bool32
+saveSnapshot( SnapshotWriter* writer,
+              GameState gameState,
+              const char* basePath,
+              const char* deltaPath,
+              bool32 compress )
+{
+        if ( SDL_AtomicGet( &writer->busy ) )
+        {
+                return false;
+        }
+        finishSnapshotWriter( writer );
+
+        World* world = gameState.world;
+        TileMap* tileMap = world->tileMap;
+        uint32 chunkCount = getTileChunkCount( tileMap );
+        uint32 chunkTileCount = getTileChunkTileCount( tileMap );
+
+        SnapshotJob* job = &writer->job;
+        if ( job->chunkCapacity < chunkCount )
+        {
+                free( job->tileChunks );
+                job->tileChunks = (TileChunk*)malloc( chunkCount * sizeof(TileChunk) );
+                job->chunkCapacity = chunkCount;
+        }
+
+        uint32 chunkBytes = chunkTileCount * sizeof(uint32);
+        if ( writer->scratchSize < lzCompressBound( chunkBytes ) )
+        {
+                free( writer->scratch );
+                writer->scratchSize = lzCompressBound( chunkBytes );
+                writer->scratch = (uint8*)malloc( writer->scratchSize );
+        }
+
+        // Sharing the chunks is the only work done on the calling thread
+        for ( uint32 chunkIndex = 0; chunkIndex < chunkCount; ++chunkIndex )
+        {
+                job->tileChunks[chunkIndex] = tileMap->tileChunks[chunkIndex];
+                retainTileChunk( job->tileChunks[chunkIndex] );
+        }
+        job->chunksRetained = chunkCount;
+        job->tileMap = *tileMap;
+        job->tileMap.tileChunks = job->tileChunks;
+        job->world = *world;
+        job->world.tileMap = &job->tileMap;
+        job->gameState = gameState;
+        job->gameState.world = &job->world;
+        job->compress = compress;
+        job->delta = (writer->base.chunkHashes && writer->base.chunkCount <= chunkCount);
+        job->isNewBase = false;
+        job->path = job->delta ? deltaPath : basePath;
+
+        // Ids must differ between runs too, or a delta left over from an
+        // earlier run could be accepted against this run's base
+        if ( writer->nextId == 0 )
+        {
+                uint64 seed = SDL_GetPerformanceCounter() ^ (uint64)(size_t)writer;
+                seed *= 0x9E3779B97F4A7C15ULL;
+                writer->nextId = ((uint64)time( 0 ) << 32) | (seed >> 32) | 1;
+        }
+
+        SDL_AtomicSet( &writer->busy, 1 );
+        writer->thread = SDL_CreateThread( snapshotThreadProc, "SnapshotWriter", writer );
+        if ( writer->thread == NULL )
+        {
+                printf( "Unable to start snapshot thread. SDL Error: %s\n", SDL_GetError() );
+                SDL_AtomicSet( &writer->busy, 0 );
+                finishSnapshotWriter( writer );
+                return false;
+        }
+        return true;
+}
+
+// Load the full snapshot at basePath and, if present, the delta at
+// deltaPath that was encoded against it
+internal bool32
+loadSnapshot( GameState* gameState,
+              const char* basePath,
+              const char* deltaPath )
+{
+        uint64 start = getPerformanceCounter();
+
+        uint32 size;
+        uint8* data = readFile( basePath, &size );
+        if ( data == NULL )
+        {
+                printf( "Unable to read snapshot %s.\n", basePath );
+                return false;
+        }
+
+        uint64 baseId = 0;
+        SnapshotStats stats;
+        bool32 result = decodeSnapshot( data, size, gameState, 0, &baseId, &stats );
+        free( data );
+
+        if ( result )
+        {
+                uint32 deltaSize;
+                uint8* delta = readFile( deltaPath, &deltaSize );
+                if ( delta )
+                {
+                        SnapshotStats deltaStats;
+                        if ( decodeSnapshot( delta, deltaSize, gameState, baseId, 0, &deltaStats ) )
+                        {
+                                stats.encodedBytes += deltaStats.encodedBytes;
+                                stats.rawBytes = deltaStats.rawBytes;
+                        }
+                        free( delta );
+                }
+
+                stats.seconds = getSecondsElapsed( start, getPerformanceCounter() );
+                printf( "Loaded %s: %u bytes to %u, %.3f ms (%.1f MB/s)\n",
+                        basePath, stats.encodedBytes, stats.rawBytes, stats.seconds * 1000.0,
+                        getMegabytesPerSecond( stats.rawBytes, stats.seconds ) );
+        }
+        return result;
+}
+
+//
+// Benchmark
+//
+
+internal void
+printSnapshotThroughput( const char* label, SnapshotStats* stats,
+                         real64 encodeSeconds, real64 decodeSeconds )
+{
+        printf( "%-12s %6u/%-6u chunks %10u bytes  encode %8.1f MB/s  decode %8.1f MB/s\n",
+                label, stats->chunksWritten, stats->chunkCount, stats->encodedBytes,
+                getMegabytesPerSecond( stats->rawBytes, encodeSeconds ),
+                getMegabytesPerSecond( stats->rawBytes, decodeSeconds ) );
+}
+
+// Measure save and load throughput on a synthetic world of the given size
+internal void
+benchmarkSnapshots( int32 tileCountX, int32 tileCountY )
+{
+        World world;
+        TileMap tileMap;
+        initializeRoomsWorld( &world, &tileMap, tileCountX, tileCountY );
+
+        GameState gameState = {};
+        gameState.world = &world;
+
+        uint32 chunkBytes = getTileChunkTileCount( &tileMap ) * sizeof(uint32);
+        uint8* scratch = (uint8*)malloc( lzCompressBound( chunkBytes ) );
+        SnapshotBuffer full = {};
+        SnapshotBuffer delta = {};
+        SnapshotBase base = {};
+        SnapshotStats stats;
+
+        printf( "Snapshot benchmark: %d x %d tiles, %u chunks\n",
+                tileCountX, tileCountY, getTileChunkCount( &tileMap ) );
+
+        for (int32 compress = 0; compress <= 1; ++compress)
+        {
+                uint64 start = getPerformanceCounter();
+                encodeSnapshot( &full, &gameState, 1, 0, &base, compress, scratch, &stats );
+                real64 encodeSeconds = getSecondsElapsed( start, getPerformanceCounter() );
+
+                start = getPerformanceCounter();
+                decodeSnapshot( full.data, full.size, &gameState, 0, 0, 0 );
+                real64 decodeSeconds = getSecondsElapsed( start, getPerformanceCounter() );
+
+                printSnapshotThroughput( compress ? "full lz" : "full raw", &stats,
+                                         encodeSeconds, decodeSeconds );
+        }
+
+        // Hold on to the chunks as saved, like a background save does,
+        // then touch one chunk in a hundred
+        uint32 chunkCount = getTileChunkCount( &tileMap );
+        base.tileChunks = (TileChunk*)malloc( chunkCount * sizeof(TileChunk) );
+        for (uint32 chunkIndex = 0; chunkIndex < chunkCount; ++chunkIndex)
+        {
+                base.tileChunks[chunkIndex] = tileMap.tileChunks[chunkIndex];
+                retainTileChunk( base.tileChunks[chunkIndex] );
+        }
+        for (uint32 chunkIndex = 0; chunkIndex < chunkCount; chunkIndex += 100)
+        {
+                makeTileChunkWritable( &tileMap, &tileMap.tileChunks[chunkIndex] );
+                tileMap.tileChunks[chunkIndex].tiles[0] ^= 1;
+        }
+
+        for (int32 compress = 0; compress <= 1; ++compress)
+        {
+                uint64 start = getPerformanceCounter();
+                encodeSnapshot( &delta, &gameState, 2, &base, 0, compress, scratch, &stats );
+                real64 encodeSeconds = getSecondsElapsed( start, getPerformanceCounter() );
+
+                start = getPerformanceCounter();
+                decodeSnapshot( delta.data, delta.size, &gameState, base.id, 0, 0 );
+                real64 decodeSeconds = getSecondsElapsed( start, getPerformanceCounter() );
+
+                printSnapshotThroughput( compress ? "delta lz" : "delta raw", &stats,
+                                         encodeSeconds, decodeSeconds );
+        }
+
+        free( full.data );
+        free( delta.data );
+        free( scratch );
+        freeSnapshotBase( &base );
+        freeTileMap( &tileMap );
+}
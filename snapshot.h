@@ -0,0 +1,87 @@
+// Snapshots
+
+#define SNAPSHOT_MAGIC 0x4E475541 // "AUGN"
+#define SNAPSHOT_VERSION 2
+
+enum SnapshotFlag
+{
+        SnapshotFlag_Delta = 0x1,
+};
+
+enum ChunkEncoding
+{
+        ChunkEncoding_Raw = 0,
+        ChunkEncoding_LZ  = 1,
+};
+
+struct SnapshotBuffer
+{
+        uint8* data;
+        uint32 size;
+        uint32 capacity;
+};
+
+struct SnapshotReader
+{
+        uint8* at;
+        uint8* end;
+        bool32 valid;
+};
+
+// Content hashes of every chunk in the snapshot that deltas are encoded
+// against, by chunk index. Chunks whose hash matches the base are left
+// out of a delta; chunks created after the base are always written.
+// tileChunks, if set, holds a reference to every chunk as it was saved:
+// a chunk whose tiles are still the same is unchanged without hashing
+// it, since the world copies a shared chunk before writing to it.
+struct SnapshotBase
+{
+        uint64 id;
+        uint32 chunkCount;
+        uint64* chunkHashes;
+        TileChunk* tileChunks;
+};
+
+struct SnapshotStats
+{
+        uint32 chunkCount;
+        uint32 chunksWritten;
+        uint32 rawBytes;
+        uint32 encodedBytes;
+        real64 seconds;
+};
+
+// State copied off the main thread so that a save can be encoded and
+// written in the background. The job holds a reference to every chunk,
+// so the live world copies a chunk before writing to it instead of the
+// main thread copying the whole world up front.
+struct SnapshotJob
+{
+        GameState gameState;
+        World world;
+        TileMap tileMap;
+        TileChunk* tileChunks;
+        uint32 chunkCapacity;
+        uint32 chunksRetained;
+        bool32 compress;
+        bool32 delta;
+        const char* path;
+
+        // Set by the snapshot thread once it has encoded a full snapshot,
+        // whose chunks then become the base's
+        bool32 isNewBase;
+};
+
+struct SnapshotWriter
+{
+        SDL_Thread* thread;
+        SDL_atomic_t busy;
+
+        SnapshotJob job;
+        SnapshotBase base;
+        uint64 nextId;
+
+        SnapshotBuffer buffer;
+        uint8* scratch;
+        uint32 scratchSize;
+};